@@ -76,6 +76,14 @@ TinyAPRS_USER_CSRC += \
 endif
 
 MOD_RADIO := 0
+
+# Receive AGC, needs CONFIG_AFSK_RX_LEVEL and an MCP41 on the SPI
+MOD_AGC := 0
+ifeq ($(MOD_AGC),1)
+TinyAPRS_USER_CSRC += \
+	$(TinyAPRS_SRC_PATH)/agc.c \
+	bertos/drv/mcp41.c
+endif
 #TinyAPRS_USER_CSRC += \
 	#$(TinyAPRS_SRC_PATH)/lcd/hw_lcd_4884.c \	
 	#$(TinyAPRS_SRC_PATH)/hw/hw_softser.c \
@@ -119,6 +127,7 @@ TinyAPRS_USER_CPPFLAGS += \
 	-D'MOD_DIGI=$(MOD_DIGI)' \
 	-D'MOD_BEACON=$(MOD_BEACON)' \
 	-D'MOD_RADIO=$(MOD_RADIO)' \
+	-D'MOD_AGC=$(MOD_AGC)' \
 	-D'MOD_CONSOLE=$(MOD_CONSOLE)'
 
 # Print binary size, make sure avr-size is in the PATH env
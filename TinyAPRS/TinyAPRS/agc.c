@@ -0,0 +1,84 @@
+/*
+ * \file agc.c
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * -->
+ *
+ * \brief Receive AGC, see agc.h.
+ */
+
+#include "agc.h"
+
+#include <cfg/macros.h>
+
+static Afsk *agc_afsk;
+
+/* Gain set on the potentiometer */
+static mcp41_res_t gain;
+
+/* Gain wanted by the AGC, set when no frame is being received */
+static mcp41_res_t target;
+
+/* Last level window seen */
+static uint8_t window;
+
+/* Low windows in a row */
+static uint8_t low_windows;
+
+STATIC_ASSERT(CFG_AGC_MIN_GAIN > 0 && CFG_AGC_INIT_GAIN <= MCP41_MAX);
+STATIC_ASSERT(CFG_AGC_LOW_LEVEL < CFG_AGC_HIGH_LEVEL);
+
+void agc_set_gain(mcp41_res_t g){
+	gain = target = MAX(g, (mcp41_res_t)CFG_AGC_MIN_GAIN);
+	mcp41_setResistance(MCP41_RX_GAIN, gain);
+}
+
+void agc_init(Afsk *af, KFile *spi){
+	agc_afsk = af;
+	window = afsk_rxLevelWindows(af);
+	low_windows = 0;
+
+	mcp41_init(spi);
+	agc_set_gain(CFG_AGC_INIT_GAIN);
+}
+
+void agc_poll(void){
+	// Do not disturb the demodulator in the middle of a frame
+	if(target != gain && !afsk_rxBusy(agc_afsk)){
+		agc_set_gain(target);
+	}
+
+	uint8_t w = afsk_rxLevelWindows(agc_afsk);
+	if(w == window){
+		return;
+	}
+	window = w;
+
+	AfskLevelStats lvl;
+	afsk_rxLevel(agc_afsk, &lvl);
+
+	// The peak the target gain would give, the gain may be held
+	uint16_t peak = (uint32_t)lvl.peak * target / gain;
+
+	if(peak >= CFG_AGC_HIGH_LEVEL){
+		// Attack, the clipped samples peak at 128 too
+		low_windows = 0;
+		target -= target / CFG_AGC_ATTACK;
+		target = MAX(target, (mcp41_res_t)CFG_AGC_MIN_GAIN);
+	}else if(peak < CFG_AGC_LOW_LEVEL && lvl.rms >= CFG_AGC_SILENCE_LEVEL){
+		// Decay
+		if(++low_windows >= CFG_AGC_DECAY_WINDOWS){
+			low_windows = 0;
+			target += target / CFG_AGC_DECAY + 1;
+			target = MIN(target, (mcp41_res_t)MCP41_MAX);
+		}
+	}else{
+		low_windows = 0;
+	}
+}
+
+mcp41_res_t agc_get_gain(void){
+	return gain;
+}
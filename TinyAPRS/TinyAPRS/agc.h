@@ -0,0 +1,58 @@
+/*
+ * \file agc.h
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * -->
+ *
+ * \brief Receive AGC, drives the MCP41 digital potentiometer at the
+ * ADC input from the modem level meter.
+ *
+ * Every level window (about 100ms) the peak of the input is compared
+ * against the CFG_AGC_HIGH_LEVEL..CFG_AGC_LOW_LEVEL band: a window above
+ * it, or with clipped samples, lowers the gain (attack), a run of
+ * CFG_AGC_DECAY_WINDOWS windows below it raises the gain (decay). Both
+ * are slow. While a frame is being received the potentiometer is not
+ * touched: the AGC goes on, scaling the measured peaks by the gain it
+ * wants over the gain set, which is applied when the frame ends.
+ * Silence does not raise the gain: the squelch of the radio may be closed.
+ */
+
+#ifndef AGC_H_
+#define AGC_H_
+
+#include "cfg/cfg_agc.h"
+
+#include <net/afsk.h>
+#include <drv/mcp41.h>
+#include <io/kfile.h>
+
+#if !CONFIG_AFSK_RX_LEVEL
+	#error The AGC needs the modem level meter, CONFIG_AFSK_RX_LEVEL
+#endif
+
+/**
+ * Initialize the AGC.
+ * \param af modem whose levels are measured.
+ * \param spi SPI channel of the MCP41.
+ */
+void agc_init(Afsk *af, KFile *spi);
+
+/**
+ * Update the gain, to be called from the main loop.
+ */
+void agc_poll(void);
+
+/**
+ * Set the gain, the AGC goes on from it.
+ * \param g gain, from 0 to MCP41_MAX.
+ */
+void agc_set_gain(mcp41_res_t g);
+
+/**
+ * \return the current gain, from 0 to MCP41_MAX.
+ */
+mcp41_res_t agc_get_gain(void);
+
+#endif /* AGC_H_ */
@@ -68,11 +68,19 @@ void beacon_broadcast_poll(void){
 	}
 	mtime_t currentTimestamp = timer_clock_seconds();
 	if(lastSendTimeSeconds == 0 ||  currentTimestamp - lastSendTimeSeconds > beaconSendInterval){
+		if(beacon_channel_busy()){
+			// try again on the next poll
+			return;
+		}
 		_send_fixed_text();
 		lastSendTimeSeconds = timer_clock_seconds();
 	}
 }
 
+bool beacon_channel_busy(void){
+	return g_settings.rf.duplex != RF_DUPLEX_FULL && afsk_dcd(&g_afsk);
+}
+
 void beacon_send(char* payload, uint8_t payloadLen){
 	CallData calldata;
 	settings_get_call_data(&calldata);
@@ -34,6 +34,12 @@ void beacon_init(beacon_exit_callback_t exitcb);
  */
 void beacon_broadcast_poll(void);
 
+/*
+ * True if the scheduled beacons must wait: half duplex and a signal
+ * on the channel (the modem carrier detect)
+ */
+bool beacon_channel_busy(void);
+
 /*
  * Send raw payload
  */
@@ -0,0 +1,43 @@
+/*
+ * \file cfg_agc.h
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * -->
+ *
+ * \brief Receive AGC configuration, see agc.h.
+ *
+ * The levels are ADC units of the level meter (the samples span from
+ * -128 to 127), the gain is the resistance of the MCP41 digital
+ * potentiometer, from 0 to MCP41_MAX.
+ */
+
+#ifndef CFG_AGC_H_
+#define CFG_AGC_H_
+
+/* Gain at power on, the middle of the potentiometer */
+#define CFG_AGC_INIT_GAIN 500
+
+/* Lowest gain, the input is never muted */
+#define CFG_AGC_MIN_GAIN 16
+
+/* The gain is lowered when a window peaks at this level or clips */
+#define CFG_AGC_HIGH_LEVEL 112
+
+/* The gain is raised when the windows peak below this level */
+#define CFG_AGC_LOW_LEVEL 80
+
+/* Windows with a lower RMS are silence (squelch closed): no gain change */
+#define CFG_AGC_SILENCE_LEVEL 3
+
+/* Attack: the gain is lowered by 1/CFG_AGC_ATTACK every window, about 1.2dB */
+#define CFG_AGC_ATTACK 8
+
+/* Decay: the gain is raised by 1/CFG_AGC_DECAY, about 0.3dB ... */
+#define CFG_AGC_DECAY 32
+
+/* ... after this many low windows in a row, a window is about 100ms */
+#define CFG_AGC_DECAY_WINDOWS 4
+
+#endif /* CFG_AGC_H_ */
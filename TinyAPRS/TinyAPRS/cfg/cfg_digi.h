@@ -23,5 +23,8 @@
 
 #define CFG_DIGI_DUP_CHECK_INTERVAL 15
 
+/* Max wait for the channel to be clear before a repeat, in ms (half duplex only) */
+#define CFG_DIGI_CSMA_TIMEOUT 3000
+
 #define CFG_DIGI_DEBUG 1
 #endif /* CFG_DIGI_H_ */
@@ -19,11 +19,21 @@
 #define KISS_LOG_FORMAT     LOG_FMT_TERSE
 
 /**
- * KISS queue length
- * for AVR chip with 4k ram, 1 or 2 is enough
- * set 0 to disable the queue for Atmega328P with 2K ram
+ * KISS queue length, max number of data frames waiting for a clear channel.
+ * The frames are queued in place in the KISS receive buffer, ahead of the
+ * frame being received, so the queue costs no RAM of its own.
+ * set 0 to disable the queue, frames are then sent with a blocking CSMA loop
  */
-#define CONFIG_KISS_QUEUE	0
+#define CONFIG_KISS_QUEUE	3
+
+/**
+ * KISS receive buffer length in bytes, the serial input is de-escaped into it.
+ * This is the read buffer of the SerialReader, shared with the console.
+ * Holds the longest AX.25 frame without the FCS, this is also the largest
+ * frame that can be queued. A frame that does not fit after the queued
+ * ones is dropped.
+ */
+#define CONFIG_KISS_RX_BUFLEN	330
 
 
 #endif /* CFG_KISS_H */
@@ -228,10 +228,11 @@
 
 /**
  * Enable SPI.
+ * Used by the receive AGC (MOD_AGC) to drive the MCP41 digital potentiometer.
  * $WIZ$ type = "boolean"
  * $WIZ$ supports = "False"
  */
-#define CONFIG_SPI_ENABLED        0
+#define CONFIG_SPI_ENABLED        MOD_AGC
 
 /**
  * Size of the outbound FIFO buffer for SPI port [bytes].
@@ -239,7 +240,7 @@
  * $WIZ$ min = 2
  * $WIZ$ supports = "avr and not xmega"
  */
-#define CONFIG_SPI_TXBUFSIZE    32
+#define CONFIG_SPI_TXBUFSIZE    4
 
 /**
  * Size of the inbound FIFO buffer for SPI port [bytes].
@@ -247,7 +248,7 @@
  * $WIZ$ min = 2
  * $WIZ$ supports = "avr and not xmega"
  */
-#define CONFIG_SPI_RXBUFSIZE    32
+#define CONFIG_SPI_RXBUFSIZE    4
 
 /**
  * Size of the outbound FIFO buffer for SPI port 0 [bytes].
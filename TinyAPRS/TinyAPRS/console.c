@@ -12,11 +12,16 @@
 #include "reader.h"
 
 #include <net/ax25.h>
+#include <net/afsk.h>
 
 #if MOD_BEACON
 #include "beacon.h"
 #endif
 
+#if MOD_AGC
+#include "agc.h"
+#endif
+
 #include <cfg/cfg_afsk.h> // afst configuration info
 #include <cfg/cfg_kiss.h> // kiss config
 
@@ -41,6 +46,14 @@ static bool cmd_send(Serial* pSer, char* command, size_t len);
 static bool cmd_test_send(Serial* pSer, char* command, size_t len);
 #endif
 
+#if CONFIG_AFSK_ISR_STATS
+static bool cmd_isr_stats(Serial* pSer, char* value, size_t len);
+#endif
+
+#if CONFIG_AFSK_RX_LEVEL
+static bool cmd_rx_level(Serial* pSer, char* value, size_t len);
+#endif
+
 struct COMMAND_ENTRY{
 	PGM_P cmdName;
 	PFUN_CMD_HANDLER cmdHandler;
@@ -191,6 +204,24 @@ static bool cmd_info(Serial* pSer, char* value, size_t len){
 	SERIAL_PRINTF_P(pSer, PSTR("RX:%d, TX:%d, ERR: %d\r\n"),g_ax25.stat.rx_ok,g_ax25.stat.tx_ok,g_ax25.stat.rx_err);
 #endif
 
+#if CONFIG_AFSK_RX_BLOCK
+	SERIAL_PRINTF_P(pSer, PSTR("RX samples dropped: %u\r\n"),afsk_rxRingOverruns(&g_afsk));
+#endif
+
+#if CONFIG_AFSK_RX_REPAIR
+	SERIAL_PRINTF_P(pSer, PSTR("RX repaired: %u\r\n"),g_afsk.repaired);
+#endif
+
+	SERIAL_PRINTF_P(pSer, PSTR("RX lock: %d, quality %u\r\n"),afsk_rxLocked(&g_afsk),afsk_rxLockQuality(&g_afsk));
+
+#if CONFIG_AFSK_RX_EQ
+	{
+		AfskEqStats eq;
+		afsk_rxEq(&g_afsk, &eq);
+		SERIAL_PRINTF_P(pSer, PSTR("RX EQ: mark %d, space %d, center %d, gain %u/64\r\n"),eq.mark,eq.space,eq.center,eq.gain);
+	}
+#endif
+
 	// print free memory
 	kfile_printf_P((KFile*)pSer,PSTR("Free RAM: %u\r\n"),freemem);
 
@@ -215,6 +246,12 @@ static bool cmd_help(Serial* pSer, char* command, size_t len){
 #endif
 	SERIAL_PRINT_P(pSer,PSTR("AT+MODE=[0|1|2]\t\t\t;Set device run mode\r\n"));
 	SERIAL_PRINT_P(pSer,PSTR("AT+KISS=[1]\t\t\t;Enter kiss mode\r\n"));
+#if CONFIG_AFSK_ISR_STATS
+	SERIAL_PRINT_P(pSer,PSTR("AT+ISR=[0]\t\t\t;Show modem ISR cycles, 0 to reset\r\n"));
+#endif
+#if CONFIG_AFSK_RX_LEVEL
+	SERIAL_PRINT_P(pSer,PSTR("AT+LEVEL=[0]\t\t\t;Show RX audio level, 0 to reset\r\n"));
+#endif
 	SERIAL_PRINT_P(pSer,PSTR("??\t\t\t\t;Display this help messages\r\n"));
 
 	SERIAL_PRINT_P(pSer,  PSTR("\r\nCopyright 2015,2016 BG5HHP(shawn.chain@gmail.com)\r\n\r\n"));
@@ -432,6 +469,48 @@ static bool cmd_send(Serial* pSer, char* value, size_t len){
 }
 #endif
 
+#if CONFIG_AFSK_ISR_STATS
+/*
+ * AT+ISR - show the modem ISR cycles, AT+ISR=0 to reset them
+ */
+static bool cmd_isr_stats(Serial* pSer, char* value, size_t len){
+	if(len == 1 && value[0] == '0'){
+		hw_afsk_isrReset();
+	}else if(len > 0){
+		return false;
+	}
+
+	AfskIsrCycles rx, tx;
+	hw_afsk_isrCycles(&rx, &tx);
+	SERIAL_PRINTF_P(pSer,PSTR("ISR budget: %u cycles\r\n"),AFSK_ISR_BUDGET);
+	SERIAL_PRINTF_P(pSer,PSTR("RX: min %u, avg %u, max %u, overruns %u\r\n"),rx.min,rx.avg,rx.max,rx.overruns);
+	SERIAL_PRINTF_P(pSer,PSTR("TX: min %u, avg %u, max %u, overruns %u\r\n"),tx.min,tx.avg,tx.max,tx.overruns);
+	return true;
+}
+#endif
+
+#if CONFIG_AFSK_RX_LEVEL
+/*
+ * AT+LEVEL - show the RX audio level, AT+LEVEL=0 to reset the clipped count
+ */
+static bool cmd_rx_level(Serial* pSer, char* value, size_t len){
+	if(len == 1 && value[0] == '0'){
+		afsk_rxLevelReset(&g_afsk);
+	}else if(len > 0){
+		return false;
+	}
+
+	AfskLevelStats lvl;
+	afsk_rxLevel(&g_afsk, &lvl);
+	SERIAL_PRINTF_P(pSer,PSTR("Audio: rms %u, peak %u, dc %d, clipped %u\r\n"),lvl.rms,lvl.peak,lvl.dc,lvl.clipped);
+	SERIAL_PRINTF_P(pSer,PSTR("Last frame: mark %u, space %u\r\n"),lvl.mark,lvl.space);
+#if MOD_AGC
+	SERIAL_PRINTF_P(pSer,PSTR("AGC gain: %u/%u\r\n"),agc_get_gain(),MCP41_MAX);
+#endif
+	return true;
+}
+#endif
+
 /*
  * Console Initialization Routine
  */
@@ -459,6 +538,14 @@ void console_init(){
     console_add_command(PSTR("SEND"),cmd_send);
 #endif
 
+#if CONFIG_AFSK_ISR_STATS
+    console_add_command(PSTR("ISR"),cmd_isr_stats);			// modem ISR timings
+#endif
+
+#if CONFIG_AFSK_RX_LEVEL
+    console_add_command(PSTR("LEVEL"),cmd_rx_level);			// RX audio level meter
+#endif
+
 	// Initialization done, display the welcome banner and settings info
 	cmd_info(&g_serial,0,0);
 }
@@ -21,6 +21,7 @@
 #include <drv/ser.h>
 #include <drv/timer.h>
 #include <io/kfile.h>
+#include <cpu/power.h>
 
 #include "global.h"
 #include "settings.h"
@@ -43,41 +44,80 @@ void digi_init(void){
 	cacheIndex = 0;
 }
 
-
-//FIXME - CSMA check ?
+/*
+ * Wait for the channel to be clear, up to CFG_DIGI_CSMA_TIMEOUT.
+ * Runs in the ax25 callback, so it can't poll the ax25 layer: the frames
+ * received meanwhile are queued by the modem. The samples are still
+ * demodulated here, so the DCD follows the channel and the sample ring
+ * doesn't overrun.
+ */
+static void _digi_wait_channel_clear(void){
+	if(g_settings.rf.duplex == RF_DUPLEX_FULL){
+		return;
+	}
+	ticks_t start = timer_clock();
+	while(afsk_dcd(&g_afsk) && timer_clock() - start < ms_to_ticks(CFG_DIGI_CSMA_TIMEOUT)){
+		cpu_relax();
+#if CONFIG_AFSK_RX_BLOCK
+		afsk_rxProcess(&g_afsk);
+#endif
+	}
+}
 
 static uint32_t c = 1;
-static bool _digi_repeat_message(AX25Msg *msg){
-	// force delay 150ms
+/*
+ * Rewrite the received frame in place and send it again: the path entry
+ * rpt is replaced by mycall, marked repeated. A WIDEn-N with N > 1 is
+ * kept after it as WIDEn-(N-1), the rest of the frame is shifted up.
+ * The FCS is computed again on the rewritten frame by ax25_sendRaw().
+ */
+static bool _digi_repeat_message(AX25View *frm, uint8_t rpt){
+	if(ax25_addrSsid(ax25_viewAddr(frm, rpt)) > 1){
+		if(!ax25_viewInsertAddr(frm, rpt)){
+			// no space left for the new digi call, drop;
+			return false;
+		}
+		// WIDEn-(N-1) follows
+		ax25_viewAddr(frm, rpt + 1)[AX25_ADDR_LEN - 1] -= 1 << 1;
+	}
+	// replace the path with digi call and mark repeated.
+	AX25Call mycall;
+	settings_get_mycall(&mycall);
+	ax25_viewSetAddr(frm, rpt, &mycall, true);
+
+	// force delay 150ms, the sender may still be keyed up
 	timer_delay(150);
+	_digi_wait_channel_clear();
 #if DIGI_DEBUG
 	kfile_printf_P(&g_serial.fd,PSTR("digipeat [%d]:\r\n"),c++);
-	ax25_print(&g_serial.fd, msg);
+	ax25_print(&g_serial.fd, frm);
 #endif
-	ax25_sendMsg(&g_ax25, msg);
+	ax25_sendRaw(&g_ax25, frm->buf, frm->len);
 	return true;
 }
 
 
 /*
- * Calculate the digi message hashcode
+ * Calculate the digi message hashcode, on the addresses as sent on the air
  */
-static uint16_t _digi_calc_hash(AX25Msg *msg){
+static uint16_t _digi_calc_hash(AX25View *frm){
 	uint16_t hash = 0;
 	size_t i = 0;
+	const uint8_t *src = ax25_viewAddr(frm, AX25_ADDR_SRC);
+	const uint8_t *dst = ax25_viewAddr(frm, AX25_ADDR_DST);
 
 	for(i = 0;i < 6;i++){	//APRS src/dst call size is fixed to 6 bytes
-		hash = hash * 31 +  msg->src.call[i];
+		hash = hash * 31 +  src[i];
 	}
-	hash = hash * 31 + msg->src.ssid;
+	hash = hash * 31 + ax25_addrSsid(src);
 
 	for(i = 0;i < 6;i++){
-		hash = hash * 31 +  msg->dst.call[i];
+		hash = hash * 31 +  dst[i];
 	}
-	hash = hash * 31 + msg->dst.ssid;
+	hash = hash * 31 + ax25_addrSsid(dst);
 
-	for(i = 0;i < msg->len;i++){
-		hash = hash * 31 + msg->info[i];
+	for(i = 0;i < frm->info_len;i++){
+		hash = hash * 31 + frm->info[i];
 	}
 	return hash;
 }
@@ -85,9 +125,9 @@ static uint16_t _digi_calc_hash(AX25Msg *msg){
 /*
  * duplication checks
  */
-static bool _digi_check_is_duplicated(AX25Msg *msg){
+static bool _digi_check_is_duplicated(AX25View *frm){
 	bool dup = false;
-	uint16_t hash = _digi_calc_hash(msg);
+	uint16_t hash = _digi_calc_hash(frm);
 	// check starts from the latest cache entry
 	for(uint8_t i = CACHE_SIZE ;cacheIndex > 0 &&  i >0 ;i--){
 		uint8_t j = (cacheIndex - 1 + i) % CACHE_SIZE;
@@ -104,38 +144,31 @@ static bool _digi_check_is_duplicated(AX25Msg *msg){
 	return dup;
 }
 
-bool digi_handle_aprs_message(struct AX25Msg *msg){
-	for(int i = 0;i < msg->rpt_cnt;i++){
-		AX25Call *rpt = msg->rpt_lst + i;
-		//uint8_t len = 5;
-		if( ((strncasecmp_P(rpt->call,PSTR("WIDE1"),5) == 0) || (strncasecmp_P(rpt->call,PSTR("WIDE2"),5) == 0) || (strncasecmp_P(rpt->call,PSTR("WIDE3"),5) == 0))
-				&& (rpt->ssid > 0)
-				&& !(AX25_REPEATED(msg,i)) ){
+/*
+ * WIDE1, WIDE2 or WIDE3 callsign, the first 5 chars compared case insensitive
+ */
+static bool _digi_is_wide(const uint8_t *addr){
+	char call[5];
+	for(uint8_t i = 0;i < sizeof(call);i++){
+		call[i] = addr[i] >> 1; // on-air shifted form
+	}
+	return (strncasecmp_P(call,PSTR("WIDE1"),5) == 0) || (strncasecmp_P(call,PSTR("WIDE2"),5) == 0) || (strncasecmp_P(call,PSTR("WIDE3"),5) == 0);
+}
+
+bool digi_handle_aprs_message(struct AX25View *frm){
+	for(uint8_t i = AX25_ADDR_RPT;i < frm->addr_cnt;i++){
+		const uint8_t *rpt = ax25_viewAddr(frm, i);
+		if(_digi_is_wide(rpt)
+				&& (ax25_addrSsid(rpt) > 0)
+				&& !ax25_addrRepeated(rpt)){
 
 			// check duplications;
-			if(_digi_check_is_duplicated(msg)){
+			if(_digi_check_is_duplicated(frm)){
 				// seems duplicated in cache, drop
 				return false;
 			}
 
-			if(rpt->ssid >1){
-				rpt->ssid--; // SSID-1
-				if(i < AX25_MAX_RPT - 1){
-					// copy WIDEn-(N-1) to next rpt list
-					AX25Call *c = rpt + 1;
-					memset(&c->call,0,6);
-					memcpy(&c->call,&rpt->call,5);
-					c->ssid = rpt->ssid;
-					msg->rpt_cnt++; // we inserted my-call as one of the rpt address.
-				}else{
-					// no space left for the new digi call, drop;
-					return false;
-				}
-			}
-			// replace the path with digi call and mark repeated.
-			settings_get_mycall(rpt);
-			AX25_SET_REPEATED(msg,i,1);
-			return _digi_repeat_message(msg);
+			return _digi_repeat_message(frm, i);
 		}
 	}// end for
 
@@ -22,8 +22,8 @@
 
 void digi_init(void);
 
-struct AX25Msg *msg;
-bool digi_handle_aprs_message(struct AX25Msg *msg);
+struct AX25View;
+bool digi_handle_aprs_message(struct AX25View *frm);
 
 
 #endif /* DIGI_H_ */
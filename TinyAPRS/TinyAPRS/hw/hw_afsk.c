@@ -42,6 +42,8 @@
 #include <net/afsk.h>
 #include <cpu/irq.h>
 
+#include <string.h> /* memset */
+
 #include <avr/io.h>
 #include <avr/interrupt.h>
 
@@ -52,16 +54,34 @@
  */
 static Afsk *ctx;
 
+#if CONFIG_AFSK_DAC_BITS == 8
+/*
+ * The DAC samples are taken every AFSK_PWM_DIV PWM periods: the sample
+ * rate must be within 0.1% of AFSK_PWM_FREQ / AFSK_PWM_DIV, the tones
+ * and the bit rate are off by the same amount. At least 2 periods are needed
+ * for afsk_dac_isr().
+ */
+STATIC_ASSERT(AFSK_PWM_DIV >= 2 && AFSK_PWM_DIV <= 255);
+STATIC_ASSERT(AFSK_PWM_FREQ * 1000UL <= AFSK_PWM_DIV * CONFIG_AFSK_DAC_SAMPLERATE * 1001UL);
+STATIC_ASSERT(AFSK_PWM_FREQ * 1000UL >= AFSK_PWM_DIV * CONFIG_AFSK_DAC_SAMPLERATE * 999UL);
+#else
+/* The DAC is written by the ADC ISR */
+STATIC_ASSERT(CONFIG_AFSK_DAC_SAMPLERATE == CONFIG_AFSK_ADC_SAMPLERATE);
+#endif
+
 void hw_afsk_adcInit(int ch, Afsk *_ctx)
 {
 	ctx = _ctx;
 	ASSERT(ch <= 5);
+#if CONFIG_AFSK_ISR_STATS
+	hw_afsk_isrReset();
+#endif
 
 	/* Set prescaler to clk/8 (2 MHz), CTC, top = ICR1 */
 	TCCR1A = 0;
 	TCCR1B = BV(CS11) | BV(WGM13) | BV(WGM12);
-	/* Set max value to obtain a 9600Hz freq */
-	ICR1 = ((CPU_FREQ / 8) / 9600) - 1;
+	/* Set max value to obtain the ADC sample rate */
+	ICR1 = ((CPU_FREQ / 8) / CONFIG_AFSK_ADC_SAMPLERATE) - 1;
 
 	/* Set reference to AVCC (5V), select CH */
 	//#define CONFIG_AFSK_ADC_USE_EXTERNAL_AREF 0 - See cfg_afsk.h
@@ -83,7 +103,92 @@ void hw_afsk_adcInit(int ch, Afsk *_ctx)
 }
 
 
+#if CONFIG_AFSK_DAC_BITS == 8
+void hw_afsk_dacInit(int ch, Afsk *_ctx)
+{
+	(void)ch;
+	(void)_ctx;
+
+	/* Fast PWM, top = 0xFF, no prescaler: 62.5kHz; non inverting on OC2B */
+	OCR2B = 128;
+	TCCR2A = BV(COM2B1) | BV(WGM21) | BV(WGM20);
+	TCCR2B = BV(CS20);
+	TIMSK2 = 0;
+
+	DDRD |= BV(3); /* D3 (OC2B) as data */
+	DDRB |= BV(0); /* D8 as PTT */
+}
+#else
 bool hw_afsk_dac_isr;
+#endif
+
+#if CONFIG_AFSK_ISR_STATS
+/*
+ * ISR timings, in Timer1 ticks (clk/8).
+ * Timer1 is the sample clock, so it gives the time left before the next
+ * sample for free: the ISR overran it if ICF1 is set again on exit.
+ * The average is kept over the last 16384..32768 runs.
+ */
+#define ISR_TICK_CYCLES 8
+#define ISR_AVG_RUNS    0x8000
+
+typedef struct IsrStat
+{
+	uint16_t min;
+	uint16_t max;
+	uint32_t sum;
+	uint16_t count;
+	uint16_t overruns;
+} IsrStat;
+
+static IsrStat isr_rx;
+static IsrStat isr_tx;
+
+INLINE uint16_t isr_ticks(uint16_t start, uint16_t end)
+{
+	return (end >= start) ? end - start : end + ICR1 + 1 - start;
+}
+
+INLINE void isr_stat_add(IsrStat *s, uint16_t ticks)
+{
+	if (ticks < s->min)
+		s->min = ticks;
+	if (ticks > s->max)
+		s->max = ticks;
+	s->sum += ticks;
+	if (++s->count == ISR_AVG_RUNS)
+	{
+		s->sum /= 2;
+		s->count /= 2;
+	}
+}
+
+static void isr_stat_get(const IsrStat *s, AfskIsrCycles *c)
+{
+	IsrStat tmp;
+
+	ATOMIC(tmp = *s);
+	c->min = tmp.count ? tmp.min * ISR_TICK_CYCLES : 0;
+	c->max = tmp.max * ISR_TICK_CYCLES;
+	c->avg = tmp.count ? tmp.sum * ISR_TICK_CYCLES / tmp.count : 0;
+	c->overruns = tmp.overruns;
+}
+
+void hw_afsk_isrCycles(AfskIsrCycles *rx, AfskIsrCycles *tx)
+{
+	isr_stat_get(&isr_rx, rx);
+	isr_stat_get(&isr_tx, tx);
+}
+
+void hw_afsk_isrReset(void)
+{
+	ATOMIC(
+		memset(&isr_rx, 0, sizeof(isr_rx));
+		memset(&isr_tx, 0, sizeof(isr_tx));
+		isr_rx.min = isr_tx.min = UINT16_MAX;
+	);
+}
+#endif
 
 /*
  * This is how you declare an ISR.
@@ -91,9 +196,80 @@ bool hw_afsk_dac_isr;
 DECLARE_ISR(ADC_vect)
 {
 	TIFR1 = BV(ICF1);
+#if CONFIG_AFSK_ISR_STATS
+	uint16_t start = TCNT1;
+#endif
+#if CONFIG_AFSK_DAC_BITS == 8
+	int16_t sample = (int16_t)((ADC) >> 2) - 128;
+
+	/*
+	 * The DAC samples of the Timer2 ISR must not wait for the demodulator:
+	 * it runs with the interrupts enabled, but this one.
+	 * Setting ADIE back clears an ADC interrupt that came in the meantime,
+	 * that sample is lost anyway: it is counted as an overrun.
+	 */
+	ADCSRA &= ~BV(ADIE);
+	IRQ_ENABLE;
+	afsk_adc_isr(ctx, sample);
+	IRQ_DISABLE;
+	ADCSRA |= BV(ADIE);
+#if CONFIG_AFSK_ISR_STATS
+	/* The Timer2 ISRs that came in the meantime are counted too */
+	isr_stat_add(&isr_rx, isr_ticks(start, TCNT1));
+	if (TIFR1 & BV(ICF1))
+		isr_rx.overruns++;
+#endif
+#else
 	afsk_adc_isr(ctx, ((int16_t)((ADC) >> 2) - 128));
+#if CONFIG_AFSK_ISR_STATS
+	uint16_t rx_end = TCNT1;
+	isr_stat_add(&isr_rx, isr_ticks(start, rx_end));
+#endif
 	if (hw_afsk_dac_isr)
+	{
 		PORTD = afsk_dac_isr(ctx) & 0xF0;
+#if CONFIG_AFSK_ISR_STATS
+		isr_stat_add(&isr_tx, isr_ticks(rx_end, TCNT1));
+		if (TIFR1 & BV(ICF1))
+			isr_tx.overruns++;
+#endif
+	}
 	else
+	{
 		PORTD = 128;
+#if CONFIG_AFSK_ISR_STATS
+		if (TIFR1 & BV(ICF1))
+			isr_rx.overruns++;
+#endif
+	}
+#endif
 }
+
+#if CONFIG_AFSK_DAC_BITS == 8
+/*
+ * Timer2 overflows at every PWM period, enabled only while transmitting.
+ * OCR2B is double buffered: the sample goes out at the next period.
+ */
+DECLARE_ISR(TIMER2_OVF_vect)
+{
+	static uint8_t periods;
+
+	if (periods)
+	{
+		periods--;
+		return;
+	}
+	periods = AFSK_PWM_DIV - 1;
+
+#if CONFIG_AFSK_ISR_STATS
+	uint16_t start = TCNT1;
+#endif
+	OCR2B = afsk_dac_isr(ctx);
+#if CONFIG_AFSK_ISR_STATS
+	uint16_t ticks = isr_ticks(start, TCNT1);
+	isr_stat_add(&isr_tx, ticks);
+	if (ticks * ISR_TICK_CYCLES >= AFSK_PWM_DIV * 256)
+		isr_tx.overruns++;
+#endif
+}
+#endif
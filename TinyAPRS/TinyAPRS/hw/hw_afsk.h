@@ -40,6 +40,9 @@
 #define HW_AFSK_H
 
 #include "cfg/cfg_arch.h"
+#include "cfg/cfg_afsk.h"
+
+#include <cfg/compiler.h>
 
 #include <avr/io.h>
 
@@ -47,15 +50,55 @@ struct Afsk;
 void hw_afsk_adcInit(int ch, struct Afsk *_ctx);
 void hw_afsk_dacInit(int ch, struct Afsk *_ctx);
 
+#if CONFIG_AFSK_ISR_STATS
+/**
+ * Cycles spent in one path of the modem ISR since the last reset.
+ * The ISR prologue and epilogue are not included.
+ */
+typedef struct AfskIsrCycles
+{
+	uint16_t min;
+	uint16_t avg;
+	uint16_t max;
+	uint16_t overruns; ///< Times the ISR was still running when the next sample was due
+} AfskIsrCycles;
+
+/** Cycles available to the ISR for every sample */
+#define AFSK_ISR_BUDGET ((uint16_t)(CPU_FREQ / CONFIG_AFSK_ADC_SAMPLERATE))
+
+/**
+ * Get the ISR timings of the receive path (demodulator) and of the
+ * transmit path (modulator, only while transmitting).
+ */
+void hw_afsk_isrCycles(AfskIsrCycles *rx, AfskIsrCycles *tx);
+void hw_afsk_isrReset(void);
+#endif
+
 /* ------------------------------------------------------------------------
  *  Configurations:
- *    D4-D7  -->  Data OUT
+ *    D4-D7  -->  Data OUT (4 bit R2R ladder, CONFIG_AFSK_DAC_BITS 4)
+ *    D3     -->  Data OUT (8 bit PWM, CONFIG_AFSK_DAC_BITS 8)
  *    D8     -->  PTT OUT
  *    D9     -->  TX(RED) LED OUT
  *    D10    -->  RX(GRN) LED OUT
  * ------------------------------------------------------------------------
  */
 
+/*
+ * DAC output.
+ * The 4 bit R2R ladder is written by the ADC ISR, at the ADC sample rate.
+ * The 8 bit DAC is the PWM of Timer2 (OC2B), at 62.5kHz: it needs a low
+ * pass RC filter, 2 cells of 4.7k and 10nF cut the carrier by some 40dB.
+ * A DAC sample is taken every AFSK_PWM_DIV PWM periods by the Timer2
+ * overflow ISR.
+ */
+#if CONFIG_AFSK_DAC_BITS == 8
+	#define AFSK_PWM_FREQ (CPU_FREQ / 256)
+	#define AFSK_PWM_DIV  DIV_ROUND(AFSK_PWM_FREQ, CONFIG_AFSK_DAC_SAMPLERATE)
+#elif CONFIG_AFSK_DAC_BITS != 4
+	#error "CONFIG_AFSK_DAC_BITS must be 4 (R2R ladder) or 8 (PWM)"
+#endif
+
 /**
  * Initialize the specified channel of the ADC for AFSK needs.
  * The adc should be configured to have a continuos stream of convertions.
@@ -107,8 +150,25 @@ void hw_afsk_dacInit(int ch, struct Afsk *_ctx);
  * \param ctx AFSK context (\see Afsk).  This parameter must be saved and
  *             passed back to afsk_dac_isr() for every convertion.
  */
+#if CONFIG_AFSK_DAC_BITS == 8
+#define AFSK_DAC_INIT(ch, ctx)   hw_afsk_dacInit(ch, ctx)
+#else
 #define AFSK_DAC_INIT(ch, ctx)   do { (void)ch, (void)ctx; DDRD |= 0xF0/*D4-D7 as data*/; DDRB |= BV(0)/*D8 as PTT*/; } while (0)
+#endif
+
+#if CONFIG_AFSK_DAC_BITS == 8
+/**
+ * Start DAC convertions on channel \a ch.
+ * \param ch DAC channel.
+ */
+#define AFSK_DAC_IRQ_START(ch)   do { (void)ch; PORTB |= BV(0)/*PTT on*/; TIFR2 = BV(TOV2); TIMSK2 |= BV(TOIE2); } while (0)
 
+/**
+ * Stop DAC convertions on channel \a ch.
+ * \param ch DAC channel.
+ */
+#define AFSK_DAC_IRQ_STOP(ch)    do { (void)ch; PORTB &= ~BV(0)/*PTT off*/; TIMSK2 &= ~BV(TOIE2); OCR2B = 128; } while (0)
+#else
 /**
  * Start DAC convertions on channel \a ch.
  * \param ch DAC channel.
@@ -120,5 +180,6 @@ void hw_afsk_dacInit(int ch, struct Afsk *_ctx);
  * \param ch DAC channel.
  */
 #define AFSK_DAC_IRQ_STOP(ch)    do { (void)ch; extern bool hw_afsk_dac_isr; PORTB &= ~BV(0)/*PTT off*/; hw_afsk_dac_isr = false; } while (0)
+#endif
 
 #endif /* HW_AFSK_H */
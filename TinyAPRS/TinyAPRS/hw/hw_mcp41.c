@@ -39,14 +39,4 @@
 #include <cfg/macros.h>
 #include <cfg/compiler.h>
 
-#warning TODO:This is an example implementation, you must implement it!
-
-const uint16_t mcp41_ports[MCP41_CNT] = 
-{
-		0, /* add here mcp41 ports */ 
-};
-const uint8_t  mcp41_pins [MCP41_CNT] = 
-{
-		0, /* add here mcp41 ports */ 
-};
-
+/* Nothing to do: the chip select pin is defined in hw_mcp41.h */
@@ -40,35 +40,34 @@
 #include "hw/mcp41_map.h"
 
 #include <cfg/compiler.h>
+#include <cfg/macros.h>
 
+#include <avr/io.h>
 
-#warning TODO:This is an example implementation, you must implement it!
-
+/*
+ * The potentiometer is on the hardware SPI, D11 (MOSI) and D13 (SCK),
+ * its chip select on A1: PORTD is rewritten by the DAC and D10 (the SPI
+ * SS pin) drives the RX led.
+ */
+#define MCP41_CS_BIT BV(PC1)
 
 INLINE void SET_MCP41_DDR(Mcp41Dev dev)
 {
-		/* Implement me! */
-		//Warning: this funtions is like avr target name,
-		//fix it to comply for all target.
-
-		//Only for test remove when implement this function
-		(void)dev;
+	(void)dev;
+	DDRC |= MCP41_CS_BIT;
 }
 
-INLINE void MCP41_ON(Mcp41Dev i)
+/* Chip select, active low */
+INLINE void MCP41_ON(Mcp41Dev dev)
 {
-		/* Implement me! */
-
-		//Only for test remove when implement this function
-		(void)i;
+	(void)dev;
+	PORTC &= ~MCP41_CS_BIT;
 }
 
-INLINE void MCP41_OFF(Mcp41Dev i)
+INLINE void MCP41_OFF(Mcp41Dev dev)
 {
-		/* Implement me! */
-
-		//Only for test remove when implement this function
-		(void)i;
+	(void)dev;
+	PORTC |= MCP41_CS_BIT;
 }
 
 #endif /* HW_MCP41_H */
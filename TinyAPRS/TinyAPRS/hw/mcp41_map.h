@@ -39,15 +39,13 @@
 #ifndef MCP41_MAP_H
 #define MCP41_MAP_H
 
-#warning TODO:This is an example implentation, you must implement it!
-
 /** \name Enum for mcp41 pot evices.
  * \{
  *
  */
 typedef enum Mcp41Dev
 {
-	MCP41_LED,
+	MCP41_RX_GAIN, ///< Receive audio gain, driven by the AGC
 
 	/* put here other mcp41 device */
 
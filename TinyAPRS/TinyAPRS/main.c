@@ -67,6 +67,11 @@ static SoftSerial softSer;
 #include "beacon.h"
 #endif
 
+#if MOD_AGC
+#include "agc.h"
+static Serial spi;
+#endif
+
 Afsk g_afsk;
 AX25Ctx g_ax25;
 Serial g_serial;
@@ -95,22 +100,22 @@ static RunMode currentMode = MODE_CFG;
 /*
  * callback when ax25 message received from radio
  */
-static void ax25_msg_callback(struct AX25Msg *msg){
+static void ax25_msg_callback(struct AX25View *frm){
 	switch(currentMode){
 	case MODE_CFG:
 		// Print received message to serial
-		ax25_print(&(g_serial.fd),msg);
+		ax25_print(&(g_serial.fd),frm);
 		break;
 
 #if MOD_KISS
 	case MODE_KISS:
-		kiss_send_to_serial(0x00/*kiss port id*/,0x00,g_ax25.buf,g_ax25.frm_len - 2);
+		kiss_send_to_serial(0x00/*kiss port id*/,0x00,frm->buf,frm->len);
 		break;
 #endif
 
 #if MOD_DIGI
 	case MODE_DIGI:
-		digi_handle_aprs_message(msg);
+		digi_handle_aprs_message(frm);
 		break;
 #endif
 
@@ -162,7 +167,7 @@ static bool cmd_switch_mode(Serial* pSer, char* value, size_t len){
 		case MODE_CFG:
 			// Enter COMMAND/CONFIG MODE
 			currentMode = MODE_CFG;
-			g_ax25.pass_through = 0;		// parse ax25 frames
+			g_ax25.pass_through = 0;		// only the UI frames
 			ser_purge(pSer);  			// clear all rx/tx buffer
 			SERIAL_PRINT_P(pSer,PSTR("Enter Config mode\r\n"));
 			break;
@@ -170,8 +175,9 @@ static bool cmd_switch_mode(Serial* pSer, char* value, size_t len){
 		case MODE_KISS:
 			// Enter KISS MODE
 			currentMode = MODE_KISS;
-			g_ax25.pass_through = 1;		// don't parse ax25 frames
+			g_ax25.pass_through = 1;		// all the frames, UI or not
 			ser_purge(pSer);  			// clear serial rx/tx buffer
+			kiss_init(&g_serialreader,&g_ax25);	// the console used the shared buffer, start with an empty queue
 			SERIAL_PRINT_P(pSer,PSTR("Enter KISS mode\r\n"));
 			break;
 #endif
@@ -190,7 +196,7 @@ static bool cmd_switch_mode(Serial* pSer, char* value, size_t len){
 		case MODE_DIGI:
 			// DIGI MODE
 			currentMode = MODE_DIGI;
-			g_ax25.pass_through = 0;		// need parse ax25 frames
+			g_ax25.pass_through = 0;		// only the UI frames
 			SERIAL_PRINT_P(pSer,PSTR("Enter Digi mode\r\n"));
 			break;
 #endif
@@ -276,6 +282,13 @@ static void init(void)
 	 * We do not need transmission for now, so we set transmission DAC channel to 0.
 	 */
 	afsk_init(&g_afsk, ADC_CH, DAC_CH);
+	settings_apply_rf();
+
+#if MOD_AGC
+	// Initialize the receive AGC, the digital potentiometer is on the SPI
+	spimaster_init(&spi, SER_SPI);
+	agc_init(&g_afsk, &spi.fd);
+#endif
 
 	/*
 	 * Here we initialize AX25 context, the channel (KFile) we are going to read messages
@@ -335,6 +348,10 @@ int main(void){
 		 */
 		ax25_poll(&g_ax25);
 
+#if MOD_AGC
+		agc_poll();
+#endif
+
 		switch(currentMode){
 			case MODE_CFG:
 #if MOD_CONSOLE
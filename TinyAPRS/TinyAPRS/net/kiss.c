@@ -1,6 +1,8 @@
 #include "kiss.h"
 
 #include <cfg/compiler.h>
+#include <cfg/macros.h>
+#include <cpu/irq.h>
 #include <algo/rand.h>
 
 #define LOG_LEVEL  KISS_LOG_LEVEL
@@ -38,6 +40,7 @@ enum {
 	KISS_CMD_TXtail,
 	KISS_CMD_FullDuplex,
 	KISS_CMD_SetHardware,
+	KISS_CMD_CONFIG_STATS = 0x0A,
 	KISS_CMD_CONFIG_TEXT = 0x0B,
 	KISS_CMD_CONFIG_CALL = 0x0C,
 	KISS_CMD_CONFIG_PARAMS = 0x0D,
@@ -46,19 +49,41 @@ enum {
 	KISS_CMD_Return = 0xFF
 };
 
+/*
+ * KISS_CMD_CONFIG_STATS ids
+ */
+enum {
+	KISS_STATS_ISR = 0x01,
+	KISS_STATS_EQ = 0x02,
+	KISS_STATS_LEVEL = 0x03,
+	KISS_STATS_ENSEMBLE = 0x04,
+	KISS_STATS_QUEUE = 0x05,
+};
+
 enum {
 	KISS_QUEUE_IDLE = 0,
 	KISS_QUEUE_DELAYED,
 };
 
+/*
+ * kiss.rxState values
+ */
+enum {
+	KISS_RX_DATA = 0,	// storing bytes
+	KISS_RX_ESCAPE,		// FESC received, the next byte is transposed
+	KISS_RX_DROP,		// bad frame, waiting for the next FEND
+};
+
 static KissCtx kiss;
 
 static bool verify_config_data(uint8_t *frame,uint16_t size);
-static void kiss_handle_frame(uint8_t *frame, uint16_t size);
+static void kiss_handle_frame(uint8_t cmd, uint8_t *payload, uint16_t len);
 static void kiss_handle_config_params_cmd(uint8_t *frame, uint16_t size);
 static void kiss_handle_config_text_cmd(uint8_t *frame, uint16_t size);
 static void kiss_handle_config_call_cmd(uint8_t *frame, uint16_t size);
 static void kiss_handle_config_magic_cmd(uint8_t *frame, uint16_t size);
+static void kiss_handle_config_stats_cmd(uint8_t *frame, uint16_t size);
+static void kiss_handle_rf_param_cmd(uint8_t cmd, uint8_t value);
 
 static void _send_to_serial_begin(uint8_t port, uint8_t cmd);
 static void _send_to_serial(uint8_t *buf, size_t len);
@@ -70,87 +95,213 @@ void kiss_init(struct SerialReader *serialReader,struct AX25Ctx *modem){
 	kiss.serialReader = serialReader;
 	kiss.modem = modem;
 
-	//kiss.serial = serialReader->ser;
 	//NOTE - Atmega328P has limited 2048 RAM, so here we have to use shared read buffer to save memory
-	//kiss.rxBuf = serialReader->buf;			// Shared buffer in SerialReader
-	//kiss.rxBufLen = serialReader->bufLen; 	// buffer length, should be >= CONFIG_AX25_FRAME_BUF_LEN
+	kiss.rxBuf = serialReader->buf;			// Shared buffer in SerialReader
+	kiss.rxBufLen = serialReader->bufLen; 	// buffer length, should be >= CONFIG_KISS_RX_BUFLEN
+}
+
+/*
+ * bytes at the front of kiss.rxBuf held by the queued frames,
+ * the frame being received is stored right after them
+ */
+INLINE uint16_t kiss_queue_used(void){
+#if CONFIG_KISS_QUEUE > 0
+	return kiss.txPos;
+#else
+	return 0;
+#endif
+}
+
+/*
+ * drop the frame being received, the bytes up to the next FEND are ignored
+ */
+INLINE void kiss_rx_drop(void){
+	kiss.rxLen = 0;
+	kiss.rxState = KISS_RX_DROP;
 }
 
+/*
+ * drain the serial rx fifo, de-escaping the bytes into kiss.rxBuf
+ *
+ * Every byte waiting in the fifo is handled in one pass, a complete frame
+ * is handled as soon as its FEND arrives. The command byte is kept apart
+ * and the payload is stored after the queued frames, so a data frame
+ * joins the tx queue where it is, without a copy.
+ */
 static void kiss_poll_serial(void){
-	SerialReader *reader = kiss.serialReader;
+	Serial *ser = kiss.serialReader->ser;
 
-	int c = ser_getchar(reader->ser); // Make sure CONFIG_SERIAL_RXTIMEOUT = 0
-	if (c == EOF) {
+	if(fifo_isempty_locked(&ser->rxfifo)){
 		return;
 	}
 
-	static bool escaped = false;
 	// sanity checks
+	// lost bytes? drop the frame
+	if(ser_getstatus(ser) & SERRF_RX){
+		LOG_INFO("Serial - Overrun\n");
+		ATOMIC(ser_setstatus(ser, ser_getstatus(ser) & ~SERRF_RX));
+		kiss_rx_drop();
+	}
+
 	// no serial input in last 2 secs?
-	if ((reader->readLen != 0)
+	if ((kiss.rxLen != 0)
 			&& (timer_clock() - kiss.rxTick > ms_to_ticks(2000L))) {
 		LOG_INFO("Serial - Timeout\n");
-		reader->readLen = 0;
+		kiss.rxLen = 0;
+		kiss.rxState = KISS_RX_DATA;
 	}
 
-	// about to overflow buffer? reset
-	if (reader->readLen >= (reader->bufLen - 2)) {
-		LOG_INFO("Serial - Packet too long %d >= %d\n", reader->readLen,
-				reader->bufLen - 2);
-		reader->readLen = 0;
-	}
+	do{
+		uint8_t c = fifo_pop_locked(&ser->rxfifo);
+
+		if(c == KISS_FEND){
+			if(kiss.rxState == KISS_RX_DATA && kiss.rxLen > 0){
+				kiss_handle_frame(kiss.rxCmd, kiss.rxBuf + kiss_queue_used(), kiss.rxLen - 1);
+			}
+			kiss.rxLen = 0;
+			kiss.rxState = KISS_RX_DATA;
+			continue;
+		}
+
+		switch(kiss.rxState){
+		case KISS_RX_DROP:
+			continue;
+		case KISS_RX_ESCAPE:
+			kiss.rxState = KISS_RX_DATA;
+			if(c == KISS_TFEND){
+				c = KISS_FEND;
+			}else if(c == KISS_TFESC){
+				c = KISS_FESC;
+			}
+			break;
+		default:
+			if(c == KISS_FESC){
+				kiss.rxState = KISS_RX_ESCAPE;
+				continue;
+			}
+			break;
+		}
+
+		if(kiss.rxLen == 0){
+			kiss.rxCmd = c;
+			kiss.rxLen++;
+			continue;
+		}
 
-	if (c == KISS_FEND) {
-		if ((!escaped) && (reader->readLen > 0)) {
-			kiss_handle_frame(reader->buf, reader->readLen);
+		// about to overflow buffer? drop it
+		uint16_t pos = kiss_queue_used() + kiss.rxLen - 1;
+		if(pos >= kiss.rxBufLen){
+			LOG_INFO("Serial - Packet too long %d\n", kiss.rxLen);
+#if CONFIG_KISS_QUEUE > 0
+			if(kiss.txCount > 0){
+				// no room left after the queued frames
+				kiss.stat.dropped++;
+			}
+#endif
+			kiss_rx_drop();
+			continue;
 		}
-		reader->readLen = 0;
-		escaped = false;
+		kiss.rxBuf[pos] = c;
+		kiss.rxLen++;
+	}while(!fifo_isempty_locked(&ser->rxfifo));
+
+	kiss.rxTick = timer_clock();
+}
+
+#if CONFIG_KISS_QUEUE > 0
+/*
+ * drop the head frame of the tx queue,
+ * the rest of the queue and the frame being received move down
+ */
+static void kiss_queue_pop(void){
+	uint16_t len = kiss.txFrmLen[0];
+	kiss.txPos -= len;
+	memmove(kiss.rxBuf, kiss.rxBuf + len, kiss.txPos + (kiss.rxLen > 0 ? kiss.rxLen - 1 : 0));
+
+	kiss.txCount--;
+	for(uint8_t i = 0;i < kiss.txCount;i++){
+		kiss.txFrmLen[i] = kiss.txFrmLen[i + 1];
+	}
+	kiss.stat.depth = kiss.txCount;
+}
+
+/*
+ * p-persistent CSMA, one step per call
+ *
+ * When the channel is clear the head frame is sent with probability P,
+ * otherwise we wait for a slot time and try again.
+ * A busy channel also costs a slot, so we never key up in the middle of a frame.
+ */
+static void kiss_poll_queue(void){
+	if(kiss.txCount == 0){
 		return;
-	} else if (c == KISS_FESC) {
-		escaped = true;
+	}
+
+	AX25Ctx *modem = kiss.modem;
+	Afsk *afsk = AFSK_CAST(modem->ch);
+	if(afsk->sending){
+		// join the transmission in progress while it has room,
+		// otherwise wait for it to finish
+		if(afsk_txBundleOk(afsk)){
+			goto send;
+		}
 		return;
-	} else if (c == KISS_TFESC) {
-		if (escaped) {
-			escaped = false;
-			c = KISS_FESC;
+	}
+
+	if(kiss.txState == KISS_QUEUE_DELAYED){
+		if(timer_clock() - kiss.txTick < ms_to_ticks(g_settings.rf.slot_time * 10L)){
+			return;
+		}
+		kiss.txState = KISS_QUEUE_IDLE;
+	}
+
+	if (g_settings.rf.duplex != RF_DUPLEX_FULL) {
+		bool clear = !afsk_dcd(afsk);
+		if(clear){
+			uint16_t i = rand();
+			uint8_t tp = ((i >> 8) ^ (i & 0xff));
+			clear = (tp < g_settings.rf.persistence);
 		}
-	} else if (c == KISS_TFEND) {
-		if (escaped) {
-			escaped = false;
-			c = KISS_FEND;
+		if(!clear){
+			kiss.txState = KISS_QUEUE_DELAYED;
+			kiss.txTick = timer_clock();
+			return;
 		}
-	} else if (escaped) {
-		escaped = false;
 	}
 
-	reader->buf[reader->readLen++] = c & 0xff;
-	kiss.rxTick = timer_clock();
+send:
+	ax25_sendRaw(modem, kiss.rxBuf, kiss.txFrmLen[0]);
+	kiss.stat.sent++;
+	kiss_queue_pop();
 }
 
+const KissQueueStat *kiss_queue_stat(void){
+	return &kiss.stat;
+}
+#endif
+
 void kiss_poll() {
 	kiss_poll_serial();
+#if CONFIG_KISS_QUEUE > 0
+	kiss_poll_queue();
+#endif
 }
 
-static void kiss_handle_frame(uint8_t *frame, uint16_t size) {
-	if (size == 0)
-		return;
-
+static void kiss_handle_frame(uint8_t cmd, uint8_t *payload, uint16_t len) {
 	// Check return command
-	if (size == 1 && frame[0] == KISS_CMD_Return) {
+	if (len == 0 && cmd == KISS_CMD_Return) {
 		//LOG_INFO("Kiss - exiting");
 		return;
 	}
 
-	if (size < 2) {
+	if (len == 0) {
 		LOG_INFO("Kiss - discarding packet - too short\n");
 		return;
 	}
 
 	// the first byte of KISS message is for command and port
-	uint8_t cmd = frame[0] & 0x0f;
-	uint8_t port = frame[0] >> 4 & 0x0f;
-	uint8_t *payload = frame + 1;
+	uint8_t port = cmd >> 4 & 0x0f;
+	cmd &= 0x0f;
 
 	if (port > 0) {
 		//WARN: ignore the port id ?
@@ -160,67 +311,46 @@ static void kiss_handle_frame(uint8_t *frame, uint16_t size) {
 	switch (cmd) {
 	case KISS_CMD_DATA:
 		//LOG_INFO("Kiss - handle frame message\n");
-		kiss_send_to_modem(payload, size - 1);
+		kiss_send_to_modem(payload, len);
 		break;
 
 	case KISS_CMD_CONFIG_PARAMS:
-		if(verify_config_data(payload,size -1)){
-			kiss_handle_config_params_cmd(payload, size - 2);
+		if(verify_config_data(payload,len)){
+			kiss_handle_config_params_cmd(payload, len - 1);
 		}
 		break;
 
 	case KISS_CMD_CONFIG_TEXT:
-		if(verify_config_data(payload,size -1)){
-			kiss_handle_config_text_cmd(payload, size - 2);
+		if(verify_config_data(payload,len)){
+			kiss_handle_config_text_cmd(payload, len - 1);
 		}
 		break;
 
 	case KISS_CMD_CONFIG_CALL:
-		if(verify_config_data(payload,size - 1)){
-			kiss_handle_config_call_cmd(payload, size - 2);
+		if(verify_config_data(payload,len)){
+			kiss_handle_config_call_cmd(payload, len - 1);
 		}
 		break;
 
 	case KISS_CMD_CONFIG_MAGIC:
-		if(verify_config_data(payload,size - 1)){
-			kiss_handle_config_magic_cmd(payload, size - 2);
+		if(verify_config_data(payload,len)){
+			kiss_handle_config_magic_cmd(payload, len - 1);
 		}
 		break;
-		/*
-		 case KISS_CMD_TXDELAY:{
-		 //LOG_INFO("Kiss - setting txdelay %d\n", k->buf[1]);
-		 if(kiss.rxBuf[1] > 0){
-		 kiss_txdelay = kiss.rxBuf[1];
-		 }
-		 break;
-		 }
-		 case KISS_CMD_P:{
-		 //LOG_INFO("Kiss - setting persistence %d\n", k->buf[1]);
-		 if(kiss.rxBuf[1] > 0){
-		 kiss_persistence = kiss.rxBuf[1];
-		 }
-		 break;
-		 }
-		 case KISS_CMD_SlotTime:{
-		 //LOG_INFO("Kiss - setting slot_time %d\n", k->buf[1]);
-		 if(kiss.rxBuf[1] > 0){
-		 kiss_slot_time = kiss.rxBuf[1];
-		 }
-		 break;
-		 }
-		 case KISS_CMD_TXtail:{
-		 LOG_INFO("Kiss - setting txtail %d\n", k->buf[1]);
-		 if(k->buf[1] > 0){
-		 kiss_txtail = k->buf[1];
-		 }
-		 break;
-		 }
-		 case KISS_CMD_FullDuplex:{
-		 LOG_INFO("Kiss - setting duplex %d\n", k->buf[1]);
-		 kiss_duplex = k->buf[1];
-		 break;
-		 }
-		 */
+
+	case KISS_CMD_CONFIG_STATS:
+		if(verify_config_data(payload,len)){
+			kiss_handle_config_stats_cmd(payload, len - 1);
+		}
+		break;
+
+	case KISS_CMD_TXDELAY:
+	case KISS_CMD_P:
+	case KISS_CMD_SlotTime:
+	case KISS_CMD_TXtail:
+	case KISS_CMD_FullDuplex:
+		kiss_handle_rf_param_cmd(cmd, payload[0]);
+		break;
 
 	default:
 		// Unsupported command
@@ -229,9 +359,9 @@ static void kiss_handle_frame(uint8_t *frame, uint16_t size) {
 }
 
 /*
- * send to modem/rf
+ * send to modem/rf, blocking until the channel is clear
  */
-void kiss_send_to_modem(/*channel = 0*/uint8_t *buf, size_t len) {
+static void kiss_csma_send(uint8_t *buf, size_t len) {
 	bool sent = false;
 	Afsk *afsk = AFSK_CAST(kiss.modem->ch);
 
@@ -243,7 +373,7 @@ void kiss_send_to_modem(/*channel = 0*/uint8_t *buf, size_t len) {
 	// Perform CSMA check under HALF_DUPLEX mode,
 	// FIXME - blocking send currently.
 	while (!sent) {
-		if (!/*ctx->dcd*/(afsk)->hdlc.rxstart) {
+		if (!afsk_dcd(afsk)) {
 			uint16_t i = rand();
 			uint8_t tp = ((i >> 8) ^ (i & 0xff));
 			if (tp < g_settings.rf.persistence) {
@@ -257,7 +387,7 @@ void kiss_send_to_modem(/*channel = 0*/uint8_t *buf, size_t len) {
 				timer_delay(g_settings.rf.slot_time * 10); // block waiting 100ms by default.
 			}
 		} else {
-			while (!sent && /*kiss_ax25->dcd*/(afsk)->hdlc.rxstart) {
+			while (!sent && afsk_dcd(afsk)) {
 				// Continously poll the modem for data
 				// while waiting, so we don't overrun
 				// receive buffers
@@ -274,6 +404,42 @@ void kiss_send_to_modem(/*channel = 0*/uint8_t *buf, size_t len) {
 	}
 }
 
+#if CONFIG_KISS_QUEUE > 0
+/*
+ * queue the frame to the modem/rf, it will be sent by kiss_poll() when the channel is clear
+ *
+ * A received KISS data frame is already in place after the queued frames,
+ * other frames are copied there and the partial KISS frame is dropped.
+ * The largest frame that can be queued is CONFIG_KISS_RX_BUFLEN bytes,
+ * less the queued ones, frames that do not fit are dropped.
+ */
+void kiss_send_to_modem(/*channel = 0*/uint8_t *buf, size_t len) {
+	uint8_t *tail = kiss.rxBuf + kiss.txPos;
+
+	if(kiss.txCount >= CONFIG_KISS_QUEUE || len > (size_t)(kiss.rxBufLen - kiss.txPos)){
+		LOG_INFO("Kiss - tx queue full, frame dropped\n");
+		kiss.stat.dropped++;
+		return;
+	}
+
+	if(buf != tail){
+		memmove(tail, buf, len);
+		kiss_rx_drop();
+	}
+	kiss.txPos += len;
+	kiss.txFrmLen[kiss.txCount++] = len;
+
+	kiss.stat.depth = kiss.txCount;
+	if(kiss.txCount > kiss.stat.maxDepth){
+		kiss.stat.maxDepth = kiss.txCount;
+	}
+}
+#else
+void kiss_send_to_modem(/*channel = 0*/uint8_t *buf, size_t len) {
+	kiss_csma_send(buf, len);
+}
+#endif
+
 #if 0
 void kiss_send_to_serial(uint8_t port, uint8_t cmd, uint8_t *buf, size_t len) {
 	size_t i;
@@ -406,6 +572,59 @@ static void kiss_respond_config_magic_cmd(uint8_t *data, uint16_t len){
 	kiss_flush_serial();
 }
 
+/*
+ * reply to a stats query, the struct starts with the stats id
+ */
+static void kiss_respond_stats(const void *stats, uint16_t len){
+	uint8_t crc = calc_crc((uint8_t*)stats,len);
+	_send_to_serial_begin(0,KISS_CMD_CONFIG_STATS);
+	_send_to_serial((uint8_t*)stats,len);
+	_send_to_serial(&crc,1);
+	_send_to_serial_end();
+	kiss_flush_serial();
+}
+
+/*
+ * TXDELAY/P/SlotTime/TXtail/FullDuplex commands,
+ * the new value is used right away and saved with the settings
+ */
+static void kiss_handle_rf_param_cmd(uint8_t cmd, uint8_t value){
+	uint8_t *param;
+
+	switch(cmd){
+	case KISS_CMD_TXDELAY:
+		param = &g_settings.rf.txdelay;
+		break;
+	case KISS_CMD_P:
+		param = &g_settings.rf.persistence;
+		break;
+	case KISS_CMD_SlotTime:
+		param = &g_settings.rf.slot_time;
+		break;
+	case KISS_CMD_TXtail:
+		param = &g_settings.rf.txtail;
+		break;
+	case KISS_CMD_FullDuplex:
+		param = &g_settings.rf.duplex;
+		value = value ? RF_DUPLEX_FULL : RF_DUPLEX_HALF;
+		break;
+	default:
+		return;
+	}
+
+	if(value == 0 && cmd != KISS_CMD_FullDuplex && cmd != KISS_CMD_TXtail){
+		// ignore the invalid values
+		return;
+	}
+
+	LOG_INFO("Kiss - setting param %d = %d\n", cmd, value);
+	if(*param != value){
+		*param = value;
+		settings_apply_rf();
+		settings_save();
+	}
+}
+
 INLINE void kiss_handle_config_params_cmd(uint8_t *data, uint16_t len) {
 	if(len == 0){
 		//read g_settings and write to serial
@@ -418,6 +637,7 @@ INLINE void kiss_handle_config_params_cmd(uint8_t *data, uint16_t len) {
 	}else if(len == sizeof(SettingsData)){
 		// set g_settings
 		settings_set_params_bytes(data,len);
+		settings_apply_rf();
 		settings_save();
 		KISS_SERIAL_RESPOND_OK();
 	}
@@ -426,13 +646,21 @@ INLINE void kiss_handle_config_params_cmd(uint8_t *data, uint16_t len) {
 INLINE void kiss_handle_config_text_cmd(uint8_t *data, uint16_t len) {
 	if(len == 0){
 		// read beacon text and write to serial
-		// NOTE: *TRICK* here: reuse the serial reader buffer, so assuming kiss.serialReader->readLen == 0
-		kiss.serialReader->readLen = 0; // force discard the received data in buffer as we'll use the buffer now.
-		uint8_t len = settings_get_beacon_text((char*)kiss.serialReader->buf,kiss.serialReader->bufLen);
+		// NOTE: the request is handled, reuse the receive buffer after the queued frames for the text
+#if CONFIG_KISS_QUEUE > 0
+		while(kiss.rxBufLen - kiss.txPos < SETTINGS_BEACON_TEXT_MAX_LEN && kiss.txCount > 0){
+			// no room for the text, send the queued frames first
+			kiss_csma_send(kiss.rxBuf, kiss.txFrmLen[0]);
+			kiss.stat.sent++;
+			kiss_queue_pop();
+		}
+#endif
+		uint8_t *buf = kiss.rxBuf + kiss_queue_used();
+		uint8_t len = settings_get_beacon_text((char*)buf,MIN((size_t)(kiss.rxBufLen - kiss_queue_used()),(size_t)UINT8_MAX));
 		if(len > 0){
-			uint8_t crc = calc_crc(kiss.serialReader->buf,len);
+			uint8_t crc = calc_crc(buf,len);
 			_send_to_serial_begin(0,KISS_CMD_CONFIG_TEXT);
-			_send_to_serial(kiss.serialReader->buf,len);
+			_send_to_serial(buf,len);
 			_send_to_serial(&crc,1);
 			_send_to_serial_end();
 		}
@@ -492,3 +720,125 @@ INLINE void kiss_handle_config_magic_cmd(uint8_t *data, uint16_t len) {
 		// ignore unknown command
 	}
 }
+
+/*
+ * query the device statistics, the first data byte is the stats id
+ *
+ * KISS request: C0 0A 01 FE C0 (ISR timings)
+ * response: 01 | BUDGET(2) | RX MIN, AVG, MAX, OVERRUNS (8) | TX MIN, AVG, MAX, OVERRUNS (8) | SUM
+ *   all values are 16 bits, in CPU byte order, the timings are in CPU cycles
+ *
+ * KISS request: C0 0A 02 FD C0 (receive equalizer)
+ * response: 02 | MARK(2) | SPACE(2) | CENTER(2) | GAIN(1) | SUM
+ *   demodulator output levels and slicer offset, signed 16 bits in CPU
+ *   byte order, gain of the FIR 2200Hz band in 1/64
+ *
+ * KISS request: C0 0A 03 FC C0 (receive audio level)
+ * response: 03 | DC(1) | RMS(1) | PEAK(1) | CLIPPED(2) | MARK(1) | SPACE(1) | SUM
+ *   input levels in ADC units (-128..127), DC signed, the clipped samples
+ *   count is 16 bits in CPU byte order, MARK and SPACE are the RMS levels
+ *   of the tones of the last decoded frame
+ *
+ * KISS request: C0 0A 04 FB C0 (ensemble demodulators)
+ * response: 04 | DUPS(2) | FRAMES(2 * CONFIG_AFSK_ENSEMBLE) | SUM
+ *   copies of delivered frames dropped, frames first delivered by each
+ *   demodulator, 16 bits in CPU byte order
+ *
+ * KISS request: C0 0A 05 FA C0 (tx queue)
+ * response: 05 | DEPTH(1) | MAX DEPTH(1) | SENT(2) | DROPPED(2) | SUM
+ *   frames waiting now and the most seen, frames sent and dropped,
+ *   16 bits in CPU byte order
+ */
+INLINE void kiss_handle_config_stats_cmd(uint8_t *data, uint16_t len) {
+	if(len != 1){
+		return;
+	}
+
+	switch(data[0]){
+#if CONFIG_AFSK_ISR_STATS
+	case KISS_STATS_ISR:
+	{
+		struct {
+			uint8_t id;
+			uint16_t budget;
+			AfskIsrCycles rx;
+			AfskIsrCycles tx;
+		} PACKED stats;
+		AfskIsrCycles rx, tx;
+		hw_afsk_isrCycles(&rx, &tx);
+		stats.id = KISS_STATS_ISR;
+		stats.budget = AFSK_ISR_BUDGET;
+		stats.rx = rx;
+		stats.tx = tx;
+
+		kiss_respond_stats(&stats,sizeof(stats));
+		break;
+	}
+#endif
+#if CONFIG_AFSK_RX_EQ
+	case KISS_STATS_EQ:
+	{
+		struct {
+			uint8_t id;
+			AfskEqStats eq;
+		} PACKED stats;
+		AfskEqStats eq;
+		afsk_rxEq(&g_afsk, &eq);
+		stats.id = KISS_STATS_EQ;
+		stats.eq = eq;
+
+		kiss_respond_stats(&stats,sizeof(stats));
+		break;
+	}
+#endif
+#if CONFIG_AFSK_RX_LEVEL
+	case KISS_STATS_LEVEL:
+	{
+		struct {
+			uint8_t id;
+			AfskLevelStats lvl;
+		} PACKED stats;
+		AfskLevelStats lvl;
+		afsk_rxLevel(&g_afsk, &lvl);
+		stats.id = KISS_STATS_LEVEL;
+		stats.lvl = lvl;
+
+		kiss_respond_stats(&stats,sizeof(stats));
+		break;
+	}
+#endif
+#if CONFIG_AFSK_ENSEMBLE
+	case KISS_STATS_ENSEMBLE:
+	{
+		struct {
+			uint8_t id;
+			AfskEnsembleStats ens;
+		} PACKED stats;
+		AfskEnsembleStats ens;
+		afsk_rxEnsemble(&g_afsk, &ens);
+		stats.id = KISS_STATS_ENSEMBLE;
+		stats.ens = ens;
+
+		kiss_respond_stats(&stats,sizeof(stats));
+		break;
+	}
+#endif
+#if CONFIG_KISS_QUEUE > 0
+	case KISS_STATS_QUEUE:
+	{
+		struct {
+			uint8_t id;
+			KissQueueStat queue;
+		} PACKED stats;
+		stats.id = KISS_STATS_QUEUE;
+		stats.queue = *kiss_queue_stat();
+
+		kiss_respond_stats(&stats,sizeof(stats));
+		break;
+	}
+#endif
+	default:
+		// ignore unknown stats
+		break;
+	}
+}
@@ -11,23 +11,34 @@ struct Serial;
 struct SerialReader;
 struct AX25Ctx;
 
+/*
+ * KISS transmit queue counters
+ */
+typedef struct KissQueueStat{
+	uint8_t depth;		// frames waiting now
+	uint8_t maxDepth;	// highest depth seen
+	uint16_t sent;		// frames handed to the modem
+	uint16_t dropped;	// frames dropped, the queue was full or had no room left
+}KissQueueStat;
+
 typedef struct KissCtx{
 	struct SerialReader *serialReader;
 	struct AX25Ctx *modem;
 
-	ticks_t  rxTick;
-#if 0
-	struct Serial  *serial;
-	uint8_t *rxBuf;
-	uint16_t rxBufLen;
-	uint16_t rxPos;
-#endif
-
-#if 0 // TX Buffering Enabled
-	uint8_t *txBuf;
-	uint16_t txBufLen;
-	uint16_t txPos;
-	ticks_t txTick;
+	uint8_t *rxBuf;								// queued frames, then the frame being received
+	uint16_t rxBufLen;							// shared read buffer of the SerialReader
+	uint16_t rxLen;								// bytes received, the command byte included
+	uint8_t rxCmd;								// command and port byte of the frame being received
+	uint8_t rxState;							// FEND/FESC decoder state
+	ticks_t  rxTick;							// last byte received
+
+#if CONFIG_KISS_QUEUE > 0 // TX Buffering Enabled
+	uint16_t txFrmLen[CONFIG_KISS_QUEUE];		// length of each queued frame, the head one first
+	uint16_t txPos;								// bytes of rxBuf used by the queued frames
+	uint8_t txCount;							// frames in the queue
+	uint8_t txState;							// CSMA state
+	ticks_t txTick;								// start of the current slot
+	KissQueueStat stat;
 #endif
 
 }KissCtx;
@@ -36,6 +47,9 @@ void kiss_init(struct SerialReader *serialReader,struct AX25Ctx *modem);
 void kiss_poll(void);
 void kiss_send_to_modem(uint8_t *buf, size_t len);
 void kiss_send_to_serial(uint8_t port, uint8_t cmd, uint8_t *buf, size_t len);
+#if CONFIG_KISS_QUEUE > 0
+const KissQueueStat *kiss_queue_stat(void);
+#endif
 
 #endif
 
@@ -20,10 +20,10 @@
 #include <drv/timer.h>
 #include "global.h"
 #include <drv/ser.h>
-#include <cfg/cfg_ax25.h>
+#include "cfg/cfg_kiss.h"
 
 #if MOD_KISS
-#define READER_BUF_LEN CONFIG_AX25_FRAME_BUF_LEN //shared buffer is 330 bytes for KISS module reading received AX25 frame.
+#define READER_BUF_LEN CONFIG_KISS_RX_BUFLEN //shared buffer is 330 bytes for KISS module reading the frames from the host.
 #else
 #define READER_BUF_LEN 128
 #endif
@@ -18,9 +18,13 @@
 
 #include <cpu/irq.h>
 #include <net/ax25.h>
+#include <net/afsk.h>
+#include "global.h"
 #include "utils.h"
 
 #define DEFAULT_BEACON_INTERVAL 20 * 60 // 20 minutes of beacon send interval
+#define DEFAULT_TXDELAY (CONFIG_AFSK_PREAMBLE_LEN / 10) // the modem timing, in 10ms units
+#define DEFAULT_TXTAIL DIV_ROUND(CONFIG_AFSK_TRAILER_LEN, 10)
 
 static const char PROGMEM DEFAULT_BEACON_TEXT[] = "!3014.00N/12009.00E>TinyAPRS Rocks!";
 
@@ -61,16 +65,20 @@ SettingsData g_settings = {
 			//.comments="TinyAPRS Rocks!",
 		},
 		.rf = {
-			.txdelay = 50,
+			.txdelay = DEFAULT_TXDELAY,
 			.persistence = 63,
-			.txtail = 5,
+			.txtail = DEFAULT_TXTAIL,
 			.slot_time = 10,
 			.duplex = RF_DUPLEX_HALF
 		},
 		.run_mode = 1
 };
 
-#define NV_SETTINGS_HEAD_BYTE_VALUE 0x88
+#define NV_SETTINGS_HEAD_BYTE_VALUE 0x89
+// settings saved before the rf txdelay/txtail were applied to the modem
+#define NV_SETTINGS_HEAD_BYTE_VALUE_V1 0x88
+#define NV_SETTINGS_V1_TXDELAY 50	// the old defaults, never used
+#define NV_SETTINGS_V1_TXTAIL 5
 uint8_t EEMEM nvSetHeadByte;
 uint8_t EEMEM nvSettings[sizeof(SettingsData)];
 uint8_t EEMEM nvSetCrcByte;
@@ -104,7 +112,7 @@ bool settings_set_params_bytes(uint8_t *bytes, uint16_t size){
  */
 bool settings_load(void){
 	uint8_t magicHead = eeprom_read_byte((void*)&nvSetHeadByte);
-	if (magicHead != NV_SETTINGS_HEAD_BYTE_VALUE) {
+	if (magicHead != NV_SETTINGS_HEAD_BYTE_VALUE && magicHead != NV_SETTINGS_HEAD_BYTE_VALUE_V1) {
 		// fill up zero values
 		return false;
 	}
@@ -118,6 +126,16 @@ bool settings_load(void){
 		// reboot()!
 		return false;
 	}
+
+	if(magicHead == NV_SETTINGS_HEAD_BYTE_VALUE_V1){
+		// the old firmware saved its unused txdelay/txtail defaults,
+		// keep the modem timing instead, once
+		if(g_settings.rf.txdelay == NV_SETTINGS_V1_TXDELAY && g_settings.rf.txtail == NV_SETTINGS_V1_TXTAIL){
+			g_settings.rf.txdelay = DEFAULT_TXDELAY;
+			g_settings.rf.txtail = DEFAULT_TXTAIL;
+		}
+		settings_save();
+	}
 	return true;
 }
 
@@ -251,3 +269,10 @@ uint8_t settings_set_beacon_text(char* data, uint8_t dataLen){
 	eeprom_update_byte((void*)&nvBeaconTextHeadByte, NV_BEACON_TEXT_HEAD_BYTE_VALUE);
 	return bytesToWrite;
 }
+
+/*
+ * Apply the rf parameters to the modem
+ */
+void settings_apply_rf(void){
+	afsk_setTiming(&g_afsk, g_settings.rf.txdelay * 10, g_settings.rf.txtail * 10);
+}
@@ -63,11 +63,11 @@ typedef struct BeaconParams{
 }BeaconParams;
 
 typedef struct RfParams{
-	uint8_t txdelay;
-	uint8_t txtail;
-	uint8_t persistence;
-	uint8_t slot_time;
-	uint8_t duplex;
+	uint8_t txdelay;		// preamble length, in 10ms units
+	uint8_t txtail;			// trailer length, in 10ms units
+	uint8_t persistence;	// CSMA persistence, send in a clear slot with probability persistence / 256
+	uint8_t slot_time;		// CSMA slot time, in 10ms units
+	uint8_t duplex;			// RF_DUPLEX_HALF or RF_DUPLEX_FULL
 }RfParams;
 
 typedef struct{
@@ -142,4 +142,9 @@ void settings_get_call_data(CallData *calldata);
  */
 void settings_get_mycall(AX25Call *call);
 
+/*
+ * Apply the rf parameters (txdelay/txtail) to the modem
+ */
+void settings_apply_rf(void);
+
 #endif /* SETTINGS_H_ */
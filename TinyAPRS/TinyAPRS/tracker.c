@@ -177,7 +177,7 @@ static void tracker_update_location(struct GPS *gps){
 		shouldSend = _fixed_interval_beacon_check();
 	}
 
-	if(shouldSend){
+	if(shouldSend && !beacon_channel_busy()){
 		// prepare payload and send
 		char payload[64];
 		char s1 = g_settings.beacon.symbol[0];
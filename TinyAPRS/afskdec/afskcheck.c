@@ -0,0 +1,261 @@
+/*
+ * \file afskcheck.c
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * -->
+ *
+ * \brief Host check of the optimized filters and tables of the modem.
+ *
+ * Every filter is run against its straight implementation on the same
+ * samples: random ones and full scale square waves, which overflow the
+ * 16 bit sums. Every output must be the same. The time per sample of
+ * both is printed.
+ *  - FIR: the folded, circular fir_filter() against the delay line
+ *    shifted on every sample, with all the coefficients multiplied;
+ *  - IIR: the discriminators with the feedback multiply of the AVR
+ *    assembly (CONFIG_AFSK_RX_ASM), modeled by iir_pole_mul_split(),
+ *    against the 32 bit multiply of the C code. The two multiplies are
+ *    also compared on every input.
+ * The wave table of the modulator, computed by the compiler, is checked
+ * against the sine of the C library.
+ *
+ * afsk.c is included, the filters are static.
+ *
+ * Usage: afskcheck [-n samples] [-r seed]
+ */
+
+#include <net/afsk.c>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/** Straight FIR filter, with all the coefficients */
+typedef struct RefFir
+{
+	uint8_t taps;
+	int8_t coef[FIR_MAX_TAPS];
+	int16_t mem[FIR_MAX_TAPS + 1];
+} RefFir;
+
+static int8_t ref_filter(RefFir *r, int8_t s)
+{
+	int16_t y = 0;
+
+	r->mem[0] = s;
+	for (int8_t i = r->taps - 1; i >= 0; i--)
+	{
+		y += r->mem[i] * r->coef[i];
+		r->mem[i + 1] = r->mem[i];
+	}
+	return (int8_t)(y / 128);
+}
+
+/* fir_filter() is inlined with a constant filter, as in the modem */
+static int8_t run_filter(enum fir_filters f, int8_t s)
+{
+	switch (f)
+	{
+	case FIR_1200_BP:
+		return fir_filter(s, FIR_1200_BP);
+	case FIR_2200_BP:
+		return fir_filter(s, FIR_2200_BP);
+	default:
+		return fir_filter(s, FIR_1200_LP);
+	}
+}
+
+static double elapsed(clock_t start, unsigned long n)
+{
+	return 1e9 * (clock() - start) / CLOCKS_PER_SEC / n;
+}
+
+/** IIR discriminator, as afsk_discriminate() */
+typedef struct IirDisc
+{
+	int8_t delay[SAMPLEPERBIT / 2];
+	uint8_t idx;
+	int16_t x, y;
+} IirDisc;
+
+typedef int16_t (*pole_mul_t)(int16_t y, uint8_t pole);
+
+static int16_t iir_run(IirDisc *d, int8_t s, uint8_t pole, uint8_t shift, pole_mul_t mul)
+{
+	int8_t delayed = d->delay[d->idx];
+	int16_t x = (delayed * s) >> shift;
+
+	d->delay[d->idx] = s;
+	d->idx = (d->idx + 1) % countof(d->delay);
+	d->y = d->x + x + mul(d->y, pole);
+	d->x = x;
+	return d->y;
+}
+
+static int16_t pole_mul_ref(int16_t y, uint8_t pole)
+{
+	return iir_pole_mul_ref(y, pole);
+}
+
+static int16_t pole_mul_split(int16_t y, uint8_t pole)
+{
+	return iir_pole_mul_split(y, pole);
+}
+
+/** \return the number of different outputs of the IIR discriminator */
+static unsigned long iir_check(const char *name, uint8_t pole, uint8_t shift,
+	const int8_t *in, unsigned long n)
+{
+	IirDisc ref, split;
+	unsigned long diff = 0;
+
+	memset(&ref, 0, sizeof(ref));
+	memset(&split, 0, sizeof(split));
+
+	clock_t start = clock();
+	for (unsigned long i = 0; i < n; i++)
+		iir_run(&ref, in[i], pole, shift, pole_mul_ref);
+	double ref_ns = elapsed(start, n);
+
+	memset(&ref, 0, sizeof(ref));
+	start = clock();
+	for (unsigned long i = 0; i < n; i++)
+		iir_run(&split, in[i], pole, shift, pole_mul_split);
+	double ns = elapsed(start, n);
+
+	memset(&split, 0, sizeof(split));
+	for (unsigned long i = 0; i < n; i++)
+		diff += iir_run(&ref, in[i], pole, shift, pole_mul_ref)
+			!= iir_run(&split, in[i], pole, shift, pole_mul_split);
+
+	printf("%-16s pole %3u: %s, %.1f ns/sample (32 bit multiply %.1f)\n",
+		name, pole, diff ? "MISMATCH" : "bit exact", ns, ref_ns);
+	return diff;
+}
+
+/** \return the number of wrong samples of the DAC wave table */
+static unsigned dac_check(void)
+{
+	unsigned diff = 0;
+
+	for (unsigned i = 0; i < DAC_TABLE_LEN; i++)
+	{
+		double level = (DAC_LEVELS - 1) / 2.0 * (1 + sin(2 * M_PI * i / DAC_TABLE_LEN));
+		unsigned sample = (unsigned)floor(level + 0.5) * (256 / DAC_LEVELS) + 128 / DAC_LEVELS;
+		if (pgm_read8(&dac_table[i]) != sample)
+		{
+			printf("  sample %u: %u, sine %u\n", i, pgm_read8(&dac_table[i]), sample);
+			diff++;
+		}
+	}
+	printf("%-16s %u bits, %u samples: %s\n", "DAC wave table",
+		CONFIG_AFSK_DAC_BITS, DAC_TABLE_LEN, diff ? "MISMATCH" : "exact");
+	return diff;
+}
+
+int main(int argc, char **argv)
+{
+	static const struct
+	{
+		const char *name;
+		uint16_t freq;
+		bool bandpass;
+	} filters[] =
+	{
+		[FIR_1200_BP] = { "1200Hz bandpass", MARK_FREQ, true },
+		[FIR_2200_BP] = { "2200Hz bandpass", SPACE_FREQ, true },
+		[FIR_1200_LP] = { "1500Hz lowpass", FIR_LP_FREQ, false },
+	};
+	unsigned long n = 1000000;
+	unsigned seed = 1;
+	int err = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (i + 1 < argc && !strcmp(argv[i], "-n"))
+			n = strtoul(argv[++i], NULL, 0);
+		else if (i + 1 < argc && !strcmp(argv[i], "-r"))
+			seed = atoi(argv[++i]);
+		else
+		{
+			fprintf(stderr, "Usage: afskcheck [-n samples] [-r seed]\n");
+			return 2;
+		}
+	}
+
+	int8_t *in = malloc(n);
+	int8_t *out = malloc(n);
+	int8_t *ref = malloc(n);
+	if (!in || !out || !ref)
+	{
+		perror("afskcheck");
+		return 1;
+	}
+
+	/* Random samples, then full scale square waves of 1 to 8 samples */
+	srand(seed);
+	for (unsigned long i = 0; i < n; i++)
+	{
+		if (i < n / 2)
+			in[i] = rand() % 256 - 128;
+		else
+			in[i] = ((i / (1 + (i >> 12) % 8)) & 1) ? 127 : -128;
+	}
+
+	printf("# %u Hz, %lu samples\n", SAMPLERATE, n);
+	for (int f = 0; f < 3; f++)
+	{
+		RefFir r;
+		memset(&r, 0, sizeof(r));
+		r.taps = FIR_TAPS(f);
+		fir_design(r.coef, r.taps, filters[f].freq, filters[f].bandpass);
+		fir_init(f, filters[f].freq, filters[f].bandpass);
+
+		clock_t start = clock();
+		for (unsigned long i = 0; i < n; i++)
+			ref[i] = ref_filter(&r, in[i]);
+		double ref_ns = elapsed(start, n);
+
+		start = clock();
+		for (unsigned long i = 0; i < n; i++)
+			out[i] = run_filter(f, in[i]);
+		double ns = elapsed(start, n);
+
+		unsigned long diff = 0;
+		for (unsigned long i = 0; i < n; i++)
+			diff += (out[i] != ref[i]);
+
+		printf("%-16s %2u taps: %s, %.1f ns/sample (straight %.1f)\n",
+			filters[f].name, r.taps, diff ? "MISMATCH" : "bit exact", ns, ref_ns);
+		if (diff)
+		{
+			printf("  %lu outputs differ\n", diff);
+			err = 1;
+		}
+	}
+
+	/* Feedback multiply, every input */
+	unsigned long diff = 0;
+	for (int32_t y = INT16_MIN; y <= INT16_MAX; y++)
+		for (uint16_t pole = 0; pole < 256; pole++)
+			diff += iir_pole_mul_split(y, pole) != iir_pole_mul_ref(y, pole);
+	printf("%-16s all inputs: %s\n", "IIR feedback", diff ? "MISMATCH" : "bit exact");
+	if (diff)
+		err = 1;
+
+	if (iir_check("Butterworth", BUTTERWORTH_POLE, BUTTERWORTH_SHIFT, in, n))
+		err = 1;
+	if (iir_check("Chebyshev", CHEBYSHEV_POLE, CHEBYSHEV_SHIFT, in, n))
+		err = 1;
+	if (dac_check())
+		err = 1;
+
+	free(in);
+	free(out);
+	free(ref);
+	return err;
+}
@@ -0,0 +1,434 @@
+/*
+ * \file afskdec.c
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * -->
+ *
+ * \brief Host AFSK decoder and benchmark.
+ *
+ * Feeds recorded audio through afsk_adc_isr() and the AX25 receiver,
+ * exactly as the firmware does, and prints the decoded frames.
+ * At the end of every input a summary is printed on stderr: frames
+ * decoded, frames with a bad CRC, receive overruns and the number of
+ * samples processed per second of CPU time.
+ *
+ * Accepted inputs are .wav (8/16 bit PCM), .au (8/16 bit linear) and raw
+ * PCM on stdin, all of them sampled at SAMPLERATE. Only the first channel
+ * of a multichannel file is decoded.
+ *
+ * Usage: afskdec [-k] [-q] [-r s8|u8|s16] [file...]
+ *  -k  print the frames in KISS form instead of TNC2
+ *  -q  print the summary only
+ *  -r  format of the raw PCM read from stdin, default s8
+ * Stdin is read when no file is given or the file name is "-".
+ */
+
+#include "cfg/cfg_afsk.h"
+#include "cfg/cfg_ax25.h"
+
+#include <net/afsk.h>
+#include <net/ax25.h>
+#include <io/kfile.h>
+#include <cpu/byteorder.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Samples fed to the modem between two ax25_poll(), about 3ms of audio */
+#define AFSKDEC_POLL_SAMPLES 32
+
+#define KISS_FEND  0xc0
+#define KISS_FESC  0xdb
+#define KISS_TFEND 0xdc
+#define KISS_TFESC 0xdd
+
+/** Sample encodings */
+typedef enum PcmFormat
+{
+	PCM_S8,
+	PCM_U8,
+	PCM_S16LE,
+	PCM_S16BE,
+} PcmFormat;
+
+/** Audio input */
+typedef struct Input
+{
+	FILE *fp;
+	PcmFormat fmt;
+	unsigned channels;
+	uint32_t rate;
+	uint32_t left; ///< Bytes of audio data still to be read
+} Input;
+
+/** KFile writing to a stdio stream */
+typedef struct StdioKFile
+{
+	KFile fd;
+	FILE *fp;
+} StdioKFile;
+
+static Afsk afsk;
+static AX25Ctx ax25;
+static StdioKFile out;
+static bool kiss_out;
+static bool quiet;
+
+static unsigned long frames;
+static unsigned long overruns;
+
+static size_t stdio_write(struct KFile *fd, const void *buf, size_t size)
+{
+	return fwrite(buf, 1, size, ((StdioKFile *)fd)->fp);
+}
+
+static void kiss_putc(uint8_t c)
+{
+	if (c == KISS_FEND)
+	{
+		putchar(KISS_FESC);
+		putchar(KISS_TFEND);
+	}
+	else if (c == KISS_FESC)
+	{
+		putchar(KISS_FESC);
+		putchar(KISS_TFESC);
+	}
+	else
+		putchar(c);
+}
+
+static void message_hook(struct AX25View *frm)
+{
+	frames++;
+	if (quiet)
+		return;
+
+	if (kiss_out)
+	{
+		putchar(KISS_FEND);
+		putchar(0x00);
+		for (size_t i = 0; i < frm->len; i++)
+			kiss_putc(frm->buf[i]);
+		putchar(KISS_FEND);
+	}
+	else
+		ax25_print(&out.fd, frm);
+}
+
+static uint16_t crc_errors(void)
+{
+#if CONFIG_AFSK_ENSEMBLE || CONFIG_AFSK_RX_FRAMES
+	return afsk.crc_errors;
+#elif CONFIG_AX25_STAT
+	return ax25.stat.rx_err;
+#else
+	return 0;
+#endif
+}
+
+static bool read_exact(FILE *fp, void *buf, size_t len)
+{
+	return fread(buf, 1, len, fp) == len;
+}
+
+static bool skip(FILE *fp, uint32_t len)
+{
+	while (len--)
+		if (fgetc(fp) == EOF)
+			return false;
+	return true;
+}
+
+static bool au_open(Input *in)
+{
+	uint32_t hdr[5]; /* offset, size, encoding, rate, channels */
+
+	if (!read_exact(in->fp, hdr, sizeof(hdr)))
+		return false;
+
+	uint32_t offset = be32_to_cpu(hdr[0]);
+	uint32_t encoding = be32_to_cpu(hdr[2]);
+
+	in->left = be32_to_cpu(hdr[1]);
+	in->rate = be32_to_cpu(hdr[3]);
+	in->channels = be32_to_cpu(hdr[4]);
+
+	if (encoding == 2)
+		in->fmt = PCM_S8;
+	else if (encoding == 3)
+		in->fmt = PCM_S16BE;
+	else
+	{
+		fprintf(stderr, "unsupported AU encoding %lu\n", (unsigned long)encoding);
+		return false;
+	}
+
+	return offset >= 24 && skip(in->fp, offset - 24);
+}
+
+static bool wav_open(Input *in)
+{
+	uint8_t riff[8];
+	bool fmt_found = false;
+
+	/* RIFF size, "WAVE" */
+	if (!read_exact(in->fp, riff, 8) || memcmp(riff + 4, "WAVE", 4))
+		return false;
+
+	for (;;)
+	{
+		uint8_t chunk[8];
+		if (!read_exact(in->fp, chunk, sizeof(chunk)))
+			return false;
+
+		uint32_t len = chunk[4] | chunk[5] << 8 | (uint32_t)chunk[6] << 16 | (uint32_t)chunk[7] << 24;
+
+		if (!memcmp(chunk, "fmt ", 4))
+		{
+			uint8_t fmt[16];
+			if (len < sizeof(fmt) || !read_exact(in->fp, fmt, sizeof(fmt)))
+				return false;
+
+			unsigned tag = fmt[0] | fmt[1] << 8;
+			unsigned bits = fmt[14] | fmt[15] << 8;
+			in->channels = fmt[2] | fmt[3] << 8;
+			in->rate = fmt[4] | fmt[5] << 8 | (uint32_t)fmt[6] << 16 | (uint32_t)fmt[7] << 24;
+
+			/* PCM or WAVE_FORMAT_EXTENSIBLE */
+			if ((tag != 1 && tag != 0xfffe) || (bits != 8 && bits != 16))
+			{
+				fprintf(stderr, "unsupported WAV format %u, %u bits\n", tag, bits);
+				return false;
+			}
+			in->fmt = (bits == 8) ? PCM_U8 : PCM_S16LE;
+			fmt_found = true;
+			len -= sizeof(fmt);
+		}
+		else if (!memcmp(chunk, "data", 4))
+		{
+			in->left = len;
+			return fmt_found;
+		}
+
+		/* Chunks are word aligned */
+		if (!skip(in->fp, len + (len & 1)))
+			return false;
+	}
+}
+
+static bool input_open(Input *in, const char *name, PcmFormat raw_fmt)
+{
+	memset(in, 0, sizeof(*in));
+	in->channels = 1;
+	in->rate = SAMPLERATE;
+	in->left = UINT32_MAX;
+
+	if (!strcmp(name, "-"))
+	{
+		in->fp = stdin;
+		in->fmt = raw_fmt;
+		return true;
+	}
+
+	in->fp = fopen(name, "rb");
+	if (!in->fp)
+	{
+		perror(name);
+		return false;
+	}
+
+	char magic[4];
+	bool ok = read_exact(in->fp, magic, sizeof(magic));
+	if (ok && !memcmp(magic, ".snd", 4))
+		ok = au_open(in);
+	else if (ok && !memcmp(magic, "RIFF", 4))
+		ok = wav_open(in);
+	else
+	{
+		fprintf(stderr, "%s: unknown file type\n", name);
+		ok = false;
+	}
+
+	if (ok && in->rate != SAMPLERATE)
+	{
+		fprintf(stderr, "%s: sample rate is %lu Hz, %d Hz is needed\n",
+			name, (unsigned long)in->rate, SAMPLERATE);
+		ok = false;
+	}
+	if (ok && in->channels == 0)
+		ok = false;
+
+	if (!ok)
+	{
+		fprintf(stderr, "%s: bad or unsupported audio file\n", name);
+		fclose(in->fp);
+	}
+	return ok;
+}
+
+/**
+ * Read up to \a n samples of the first channel.
+ * \return the number of samples read, 0 at the end of the input.
+ */
+static size_t input_read(Input *in, int8_t *samples, size_t n)
+{
+	static uint8_t raw[8192];
+	size_t width = (in->fmt == PCM_S8 || in->fmt == PCM_U8) ? 1 : 2;
+	size_t frame = width * in->channels;
+	size_t len = MIN(n * frame, sizeof(raw) / frame * frame);
+
+	len = MIN((uint32_t)len, in->left);
+	len = fread(raw, 1, len, in->fp) / frame;
+	in->left -= len * frame;
+
+	for (size_t i = 0; i < len; i++)
+	{
+		const uint8_t *s = raw + i * frame;
+
+		switch (in->fmt)
+		{
+		case PCM_S8:
+			samples[i] = (int8_t)s[0];
+			break;
+		case PCM_U8:
+			samples[i] = (int8_t)(s[0] - 128);
+			break;
+		case PCM_S16LE:
+			samples[i] = (int8_t)s[1];
+			break;
+		case PCM_S16BE:
+			samples[i] = (int8_t)s[0];
+			break;
+		}
+	}
+	return len;
+}
+
+static void decode(const char *name, Input *in)
+{
+	int8_t samples[4096];
+	unsigned long total = 0;
+	size_t n;
+
+	afsk_init(&afsk, 0, 0);
+	ax25_init(&ax25, &afsk.fd, message_hook);
+	frames = 0;
+	overruns = 0;
+
+	clock_t start = clock();
+	while ((n = input_read(in, samples, countof(samples))) > 0)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			afsk_adc_isr(&afsk, samples[i]);
+
+			if (++total % AFSKDEC_POLL_SAMPLES == 0)
+			{
+				/* ax25_poll() clears the error */
+				if (kfile_error(&afsk.fd) & AFSK_RXFIFO_OVERRUN)
+					overruns++;
+				ax25_poll(&ax25);
+			}
+		}
+	}
+	if (kfile_error(&afsk.fd) & AFSK_RXFIFO_OVERRUN)
+		overruns++;
+	ax25_poll(&ax25);
+	double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	fflush(stdout);
+	fprintf(stderr, "%s: %lu frames, %u CRC errors, %lu overruns, %lu samples",
+		name, frames, crc_errors(), overruns, total);
+#if CONFIG_AFSK_RX_BLOCK
+	fprintf(stderr, " (%u dropped)", afsk_rxRingOverruns(&afsk));
+#endif
+#if CONFIG_AFSK_RX_REPAIR
+	fprintf(stderr, ", %u repaired", afsk.repaired);
+#endif
+#if CONFIG_AFSK_ENSEMBLE
+	AfskEnsembleStats ens;
+	afsk_rxEnsemble(&afsk, &ens);
+	fprintf(stderr, ", %u dups, by demod", ens.dups);
+	for (int i = 0; i < CONFIG_AFSK_ENSEMBLE; i++)
+		fprintf(stderr, "%c%u", i ? '/' : ' ', ens.frames[i]);
+#endif
+#if CONFIG_AFSK_RX_EQ
+	AfskEqStats eq;
+	afsk_rxEq(&afsk, &eq);
+	fprintf(stderr, ", eq %d/%d center %d gain %u/64", eq.mark, eq.space, eq.center, eq.gain);
+#endif
+#if CONFIG_AFSK_RX_LEVEL
+	AfskLevelStats lvl;
+	afsk_rxLevel(&afsk, &lvl);
+	fprintf(stderr, ", level dc %d rms %u peak %u clipped %u mark %u space %u",
+		lvl.dc, lvl.rms, lvl.peak, lvl.clipped, lvl.mark, lvl.space);
+#endif
+	if (secs > 0)
+		fprintf(stderr, ", %.0f samples/s (%.0fx realtime)",
+			total / secs, total / secs / SAMPLERATE);
+	fputc('\n', stderr);
+}
+
+static int decode_file(const char *name, PcmFormat raw_fmt)
+{
+	Input in;
+
+	if (!input_open(&in, name, raw_fmt))
+		return 1;
+
+	decode(name, &in);
+	if (in.fp != stdin)
+		fclose(in.fp);
+	return 0;
+}
+
+static void usage(void)
+{
+	fprintf(stderr, "Usage: afskdec [-k] [-q] [-r s8|u8|s16] [file...]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	PcmFormat raw_fmt = PCM_S8;
+	int i;
+	int ret = 0;
+
+	for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++)
+	{
+		if (!strcmp(argv[i], "-k"))
+			kiss_out = true;
+		else if (!strcmp(argv[i], "-q"))
+			quiet = true;
+		else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+		{
+			const char *f = argv[++i];
+			if (!strcmp(f, "s8"))
+				raw_fmt = PCM_S8;
+			else if (!strcmp(f, "u8"))
+				raw_fmt = PCM_U8;
+			else if (!strcmp(f, "s16"))
+				raw_fmt = PCM_S16LE;
+			else
+				usage();
+		}
+		else
+			usage();
+	}
+
+	kfile_init(&out.fd);
+	out.fd.write = stdio_write;
+	out.fp = stdout;
+
+	if (i == argc)
+		return decode_file("-", raw_fmt);
+
+	for (; i < argc; i++)
+		ret |= decode_file(argv[i], raw_fmt);
+	return ret;
+}
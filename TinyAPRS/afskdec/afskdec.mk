@@ -0,0 +1,163 @@
+#
+# Host AFSK decoder and benchmarks.
+#
+# Both tools run the firmware modem, one executable for every
+# discriminator filter:
+#  - afskdec decodes recorded audio;
+#  - afsksim sends test frames through a simulated channel and
+#    prints the decode rate against the SNR.
+# The _ensemble variants run the four demodulators of the ensemble mode.
+# afskcheck checks the optimized filters of the modem against their
+# straight implementation, bit for bit.
+# repaircheck checks the repair of the frames received with a bad CRC.
+# crccheck checks and times every CRC-CCITT method, one executable
+# for each.
+#
+#   make afskdec
+#   make afskdec_bench AFSKDEC_INPUT=track1.wav
+#   make afsksim_bench AFSKSIM_ARGS="-t -6 -d 200"
+#   make afskcheck_run
+#   make repaircheck_run
+#   make crccheck_run
+#
+# The firmware configuration is used, the differences are in
+# afskdec/cfg/cfg_afsk.h and afskdec/cfg/cfg_crc_ccitt.h.
+#
+
+AFSKDEC_PATH = afskdec
+
+AFSKDEC_TRG = \
+	afskdec_butterworth \
+	afskdec_chebyshev \
+	afskdec_fir \
+	afskdec_ensemble
+
+AFSKSIM_TRG = \
+	afsksim_butterworth \
+	afsksim_chebyshev \
+	afsksim_fir \
+	afsksim_ensemble
+
+AFSKDEC_CSRC = \
+	bertos/net/afsk.c \
+	bertos/net/ax25.c \
+	bertos/algo/crc_ccitt.c \
+	bertos/io/kfile.c \
+	bertos/mware/formatwr.c \
+	bertos/mware/hex.c \
+	bertos/drv/mcp41.c \
+	$(TinyAPRS_SRC_PATH)/agc.c
+
+# Headers are looked up in the decoder directory first, then in the
+# firmware one: only hw_afsk.h, hw_mcp41.h and cfg_afsk.h are replaced.
+AFSKDEC_CPPFLAGS = \
+	-D'ARCH=(ARCH_UNITTEST)' \
+	-I$(AFSKDEC_PATH) \
+	-I$(TinyAPRS_SRC_PATH) \
+	-O2 \
+	-fno-strict-aliasing \
+	-fwrapv
+
+# Tool, variant, filter, extra flags
+define afskdec_target
+$(1)_$(2)_HOSTED = 1
+$(1)_$(2)_PREFIX =
+$(1)_$(2)_SUFFIX =
+$(1)_$(2)_CSRC = $(AFSKDEC_PATH)/$(1).c $$(AFSKDEC_CSRC)
+$(1)_$(2)_CPPFLAGS = $$(AFSKDEC_CPPFLAGS) -D'AFSKDEC_FILTER=$(3)' $(4)
+endef
+
+$(eval $(call afskdec_target,afskdec,butterworth,AFSK_BUTTERWORTH))
+$(eval $(call afskdec_target,afskdec,chebyshev,AFSK_CHEBYSHEV))
+$(eval $(call afskdec_target,afskdec,fir,AFSK_FIR))
+$(eval $(call afskdec_target,afskdec,ensemble,AFSK_FIR,-D'AFSKDEC_ENSEMBLE=4'))
+$(eval $(call afskdec_target,afsksim,butterworth,AFSK_BUTTERWORTH))
+$(eval $(call afskdec_target,afsksim,chebyshev,AFSK_CHEBYSHEV))
+$(eval $(call afskdec_target,afsksim,fir,AFSK_FIR))
+$(eval $(call afskdec_target,afsksim,ensemble,AFSK_FIR,-D'AFSKDEC_ENSEMBLE=4'))
+
+# afskcheck includes afsk.c; the ensemble builds the FIR and the IIR filters
+afskcheck_HOSTED = 1
+afskcheck_PREFIX =
+afskcheck_SUFFIX =
+afskcheck_CSRC = $(AFSKDEC_PATH)/afskcheck.c $(filter-out bertos/net/afsk.c,$(AFSKDEC_CSRC))
+afskcheck_CPPFLAGS = $(AFSKDEC_CPPFLAGS) -D'AFSKDEC_ENSEMBLE=3'
+
+# repaircheck includes afsk.c, with the repair of two tones
+repaircheck_HOSTED = 1
+repaircheck_PREFIX =
+repaircheck_SUFFIX =
+repaircheck_CSRC = $(AFSKDEC_PATH)/repaircheck.c $(filter-out bertos/net/afsk.c,$(AFSKDEC_CSRC))
+repaircheck_CPPFLAGS = $(AFSKDEC_CPPFLAGS) -D'AFSKDEC_REPAIR=2'
+
+# Method
+define crccheck_target
+crccheck_$(1)_HOSTED = 1
+crccheck_$(1)_PREFIX =
+crccheck_$(1)_SUFFIX =
+crccheck_$(1)_CSRC = $(AFSKDEC_PATH)/crccheck.c bertos/algo/crc_ccitt.c
+crccheck_$(1)_CPPFLAGS = $$(AFSKDEC_CPPFLAGS) -D'CRCCHECK_METHOD=$(2)'
+endef
+
+CRCCHECK_TRG = \
+	crccheck_bit \
+	crccheck_nibble \
+	crccheck_byte \
+	crccheck_slice4 \
+	crccheck_slice8
+
+$(eval $(call crccheck_target,bit,CRC_CCITT_BIT))
+$(eval $(call crccheck_target,nibble,CRC_CCITT_NIBBLE))
+$(eval $(call crccheck_target,byte,CRC_CCITT_BYTE))
+$(eval $(call crccheck_target,slice4,CRC_CCITT_SLICE4))
+$(eval $(call crccheck_target,slice8,CRC_CCITT_SLICE8))
+
+$(foreach t,$(AFSKDEC_TRG) $(AFSKSIM_TRG) afskcheck repaircheck $(CRCCHECK_TRG),$(eval $(call build_target,$(t))))
+-include $(foreach t,$(AFSKDEC_TRG) $(AFSKSIM_TRG) afskcheck repaircheck $(CRCCHECK_TRG),$($(t)_OBJ:%.o=%.d))
+
+.PHONY: afskdec afsksim afskcheck repaircheck crccheck
+afskdec: $(AFSKDEC_TRG:%=$(OUTDIR)/%)
+afsksim: $(AFSKSIM_TRG:%=$(OUTDIR)/%)
+afskcheck: $(OUTDIR)/afskcheck
+repaircheck: $(OUTDIR)/repaircheck
+crccheck: $(CRCCHECK_TRG:%=$(OUTDIR)/%)
+
+# Run every filter variant on the same recording
+AFSKDEC_INPUT ?=
+.PHONY: afskdec_bench
+afskdec_bench: afskdec
+	@if [ -z "$(AFSKDEC_INPUT)" ] ; then \
+		printf "Usage: make afskdec_bench AFSKDEC_INPUT=<file.wav|file.au>\n" ; \
+		exit 1 ; \
+	fi
+	$Q for t in $(AFSKDEC_TRG) ; do \
+		printf "%-20s " $$t ; \
+		$(OUTDIR)/$$t -q $(AFSKDEC_INPUT) || exit 1 ; \
+	done
+
+# Decode rate against SNR of every filter variant
+AFSKSIM_ARGS ?=
+.PHONY: afsksim_bench
+afsksim_bench: afsksim
+	$Q for t in $(AFSKSIM_TRG) ; do \
+		printf "# %s\n" $$t ; \
+		$(OUTDIR)/$$t $(AFSKSIM_ARGS) || exit 1 ; \
+	done
+
+# Optimized filters bit exact against the straight ones
+.PHONY: afskcheck_run
+afskcheck_run: afskcheck
+	$Q $(OUTDIR)/afskcheck
+
+# Frames with flipped tones repaired, once
+.PHONY: repaircheck_run
+repaircheck_run: repaircheck
+	$Q $(OUTDIR)/repaircheck
+
+# Every CRC-CCITT method bit exact against the bit serial CRC, and timed
+CRCCHECK_ARGS ?=
+.PHONY: crccheck_run
+crccheck_run: crccheck
+	$Q for t in $(CRCCHECK_TRG) ; do \
+		$(OUTDIR)/$$t $(CRCCHECK_ARGS) || exit 1 ; \
+	done
@@ -0,0 +1,584 @@
+/*
+ * \file afsksim.c
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * -->
+ *
+ * \brief Host AFSK channel simulator and decode-vs-SNR benchmark.
+ *
+ * Test frames are generated by the firmware modulator (afsk_dac_isr()),
+ * passed through a simulated radio channel and fed to afsk_adc_isr() of a
+ * second modem. The DAC output is sampled at the ADC sample rate. For every SNR of the sweep one line is printed with the
+ * number and the percentage of the frames decoded, and the data carrier
+ * detect figures: the mean delay to assert it from the key-up of the
+ * transmitter, the time without it on the air after that and the time
+ * with it in silence (noise only, DCD_GRACE after the frames excluded).
+ *
+ * The channel applies, in this order:
+ *  - twist: first order emphasis, the 2200Hz tone is \a twist dB louder
+ *    than the 1200Hz one (negative values give de-emphasis); one section
+ *    gives at most 4.7dB, up to EMPH_STAGES sections are cascaded;
+ *  - tone frequency offset, by single sideband mixing;
+ *  - sample clock drift between the two modems, in ppm;
+ *  - white gaussian noise, the SNR is the power of the undistorted tones
+ *    against the noise power in the whole 0..SAMPLERATE/2 band;
+ *  - clipping at a fraction of the undistorted tone amplitude,
+ *    0 (the default) for none;
+ *  - audio level of the radio, in dB, 0 (the default) for the tones at
+ *    TONE_AMPL;
+ *  - with -a, the front end gain set by the AGC (agc.c) through the MCP41
+ *    digital potentiometer: AGC_FRONTEND_GAIN times the wiper position.
+ * The ADC clips the result at -128 and 127.
+ *
+ * Usage: afsksim [-n frames] [-s snr|from:to:step] [-t twist_db]
+ *                [-f offset_hz] [-d drift_ppm] [-c clip] [-p txdelay_ms]
+ *                [-g level_db] [-a agc_gain] [-r seed] [-w file.au]
+ * -p sets the preamble of the frames, to test the clock acquisition.
+ * -a runs the AGC, starting from the given gain (0..MCP41_MAX), the gain
+ * reached at the end of every run is printed.
+ * -w writes the audio of the first SNR of the sweep, it can be fed
+ * to afskdec.
+ */
+
+#include "cfg/cfg_afsk.h"
+
+#include <net/afsk.h>
+#include <net/ax25.h>
+#include <io/kfile.h>
+#include <cpu/byteorder.h>
+#include <drv/mcp41.h>
+
+#include "agc.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Samples fed to the modem between two ax25_poll(), about 3ms of audio */
+#define AFSKSIM_POLL_SAMPLES 32
+
+/* Amplitude of the undistorted tones, leaves room for the noise */
+#define TONE_AMPL 48.0
+
+/* Hilbert transformer length, used for the frequency offset */
+#define HILBERT_TAPS 31
+
+/* Longest silence between two frames, in samples */
+#define MAX_GAP (SAMPLERATE / 4)
+
+#define MAX_FRAMES 10000
+
+/* Emphasis sections, each one gives up to EMPH_MAX_TWIST dB */
+#define EMPH_STAGES    4
+#define EMPH_MAX_TWIST 4.0
+
+/* Silence after a transmission not counted for the false carrier detect */
+#define DCD_GRACE (SAMPLERATE / 10)
+
+/* The DAC output is sampled by the ADC */
+STATIC_ASSERT(CONFIG_AFSK_DAC_SAMPLERATE >= SAMPLERATE);
+
+/* Front end gain with the potentiometer at MCP41_HW_MAX, 1 at a quarter */
+#define AGC_FRONTEND_GAIN 4.0
+
+/* Bell 202 tones */
+#define MARK_FREQ  1200
+#define SPACE_FREQ 2200
+
+/** Channel impairments and their state */
+typedef struct Channel
+{
+	/* Settings */
+	double twist;
+	double offset;
+	double drift;
+	double clip;     ///< 0 for no clipping
+	double noise;    ///< Noise standard deviation
+	double level;    ///< Audio level of the radio, linear
+
+	/* Emphasis filter */
+	int emph_stages;
+	double emph_a;   ///< Pre-emphasis: y = g * (x + a * (x - x1))
+	double emph_b;   ///< De-emphasis: y = g * (y1 + b * (x - y1))
+	double emph_g;
+	double emph_x1[EMPH_STAGES];
+	double emph_y1[EMPH_STAGES];
+
+	/* Frequency shifter */
+	double hilbert[HILBERT_TAPS];
+	double hist[HILBERT_TAPS];
+	int hist_idx;
+	double phase;
+
+	/* Resampler */
+	double rs[4];
+	double rs_pos;
+} Channel;
+
+/** MCP41 digital potentiometer on the SPI, see hw/hw_mcp41.h */
+typedef struct Mcp41Model
+{
+	KFile fd;
+	bool cmd;        ///< A command byte was received, the wiper follows
+	uint8_t wiper;   ///< From 0 to MCP41_HW_MAX
+} Mcp41Model;
+
+static Afsk tx;
+static AX25Ctx tx_ax25;
+static Afsk rx;
+static AX25Ctx rx_ax25;
+
+static Channel chan;
+static Mcp41Model pot;
+static bool agc;
+static mcp41_res_t agc_start;
+static FILE *au_out;
+static uint32_t au_len;
+static unsigned long rx_samples;
+
+/* Carrier detect: a frame is on the air, samples since the end of the last one */
+static bool on_air;
+static unsigned long gap_samples;
+/* Carrier detect counters, see dcd_count() */
+static unsigned long dcd_delay, dcd_asserted, dcd_air, dcd_lost, dcd_noise, dcd_false;
+
+/* DAC sample clock, in 1/SAMPLERATE of a DAC sample */
+static unsigned long tx_clock;
+
+static bool received[MAX_FRAMES];
+static unsigned nframes = 100;
+static unsigned txdelay = CONFIG_AFSK_PREAMBLE_LEN;
+
+/** Uniform in (0, 1) */
+static double uniform(void)
+{
+	return (rand() + 1.0) / (RAND_MAX + 2.0);
+}
+
+static double gauss(void)
+{
+	return sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform());
+}
+
+/** Gain of the emphasis filter at frequency \a f */
+static double emph_gain(double a, double b, double f)
+{
+	double w = 2 * M_PI * f / SAMPLERATE;
+	double re, im;
+
+	if (b)
+	{
+		/* b / (1 - (1 - b) z^-1) */
+		re = 1 - (1 - b) * cos(w);
+		im = (1 - b) * sin(w);
+		return b / sqrt(re * re + im * im);
+	}
+	/* 1 + a (1 - z^-1) */
+	re = 1 + a - a * cos(w);
+	im = a * sin(w);
+	return sqrt(re * re + im * im);
+}
+
+/** Twist of the emphasis filter, space gain over mark gain in dB */
+static double emph_twist(double a, double b)
+{
+	return 20 * log10(emph_gain(a, b, SPACE_FREQ) / emph_gain(a, b, MARK_FREQ));
+}
+
+static void channel_init(Channel *ch)
+{
+	/* Find the emphasis coefficient giving the requested twist */
+	double lo = 0, hi = (ch->twist >= 0) ? 64 : 1;
+
+	ch->emph_stages = (int)ceil(fabs(ch->twist) / EMPH_MAX_TWIST);
+	ch->emph_a = ch->emph_b = 0;
+	for (int i = 0; ch->twist && i < 60; i++)
+	{
+		double mid = (lo + hi) / 2;
+		double t = (ch->twist > 0) ? emph_twist(mid, 0) : emph_twist(0, 1 - mid);
+		if (fabs(t) * ch->emph_stages < fabs(ch->twist))
+			lo = mid;
+		else
+			hi = mid;
+	}
+	if (ch->twist > 0)
+		ch->emph_a = lo;
+	else if (ch->twist < 0)
+		ch->emph_b = 1 - lo;
+
+	/* Mark tone keeps its amplitude */
+	ch->emph_g = 1 / emph_gain(ch->emph_a, ch->emph_b, MARK_FREQ);
+	for (int i = 0; i < EMPH_STAGES; i++)
+		ch->emph_x1[i] = ch->emph_y1[i] = 0;
+
+	/* Hamming windowed Hilbert transformer */
+	for (int i = 0; i < HILBERT_TAPS; i++)
+	{
+		int n = i - HILBERT_TAPS / 2;
+		double w = 0.54 - 0.46 * cos(2 * M_PI * i / (HILBERT_TAPS - 1));
+		ch->hilbert[i] = (n & 1) ? 2 / (M_PI * n) * w : 0;
+		ch->hist[i] = 0;
+	}
+	ch->hist_idx = 0;
+	ch->phase = 0;
+
+	memset(ch->rs, 0, sizeof(ch->rs));
+	ch->rs_pos = 0;
+}
+
+static size_t mcp41_write(struct KFile *fd, const void *buf, size_t size)
+{
+	Mcp41Model *m = (Mcp41Model *)fd;
+	const uint8_t *c = (const uint8_t *)buf;
+
+	for (size_t i = 0; i < size; i++)
+	{
+		if (m->cmd)
+			m->wiper = c[i];
+		m->cmd = !m->cmd && c[i] == MCP41_WRITE_DATA;
+	}
+	return size;
+}
+
+/**
+ * Count the carrier detect state: on the air the delay to assert it and
+ * the samples without it after that, in silence (noise only) the samples
+ * with it, from DCD_GRACE after the end of the frame.
+ */
+static void dcd_count(void)
+{
+	bool dcd = afsk_dcd(&rx);
+
+	if (on_air)
+	{
+		gap_samples = 0;
+		if (!dcd_asserted)
+			dcd_delay++;
+		else
+		{
+			dcd_air++;
+			dcd_lost += !dcd;
+		}
+		dcd_asserted |= dcd;
+	}
+	else if (++gap_samples > DCD_GRACE)
+	{
+		dcd_noise++;
+		dcd_false += dcd;
+	}
+}
+
+static void rx_put(double x)
+{
+	x += chan.noise * gauss();
+	if (chan.clip)
+		x = MINMAX(-chan.clip * TONE_AMPL, x, chan.clip * TONE_AMPL);
+
+	x *= chan.level;
+	if (agc)
+		x *= AGC_FRONTEND_GAIN * pot.wiper / MCP41_HW_MAX;
+
+	int8_t s = (int8_t)lrint(MINMAX(-128.0, x, 127.0));
+
+	if (au_out)
+	{
+		fputc(s, au_out);
+		au_len++;
+	}
+
+	afsk_adc_isr(&rx, s);
+	dcd_count();
+	if (++rx_samples % AFSKSIM_POLL_SAMPLES == 0)
+	{
+		ax25_poll(&rx_ax25);
+		if (agc)
+			agc_poll();
+	}
+}
+
+/** Catmull-Rom interpolation between rs[1] and rs[2] */
+static double interp(const double *y, double t)
+{
+	return y[1] + 0.5 * t * (y[2] - y[0]
+		+ t * (2 * y[0] - 5 * y[1] + 4 * y[2] - y[3]
+		+ t * (3 * (y[1] - y[2]) + y[3] - y[0])));
+}
+
+static void channel_put(Channel *ch, double x)
+{
+	/* Twist */
+	for (int i = 0; i < ch->emph_stages; i++)
+	{
+		if (ch->emph_a)
+		{
+			double y = x + ch->emph_a * (x - ch->emph_x1[i]);
+			ch->emph_x1[i] = x;
+			x = y;
+		}
+		else
+			x = ch->emph_y1[i] = ch->emph_y1[i] + ch->emph_b * (x - ch->emph_y1[i]);
+		x *= ch->emph_g;
+	}
+
+	/* Frequency offset */
+	if (ch->offset)
+	{
+		ch->hist[ch->hist_idx] = x;
+		double im = 0;
+		for (int i = 0; i < HILBERT_TAPS; i++)
+			im += ch->hilbert[i] * ch->hist[(ch->hist_idx + HILBERT_TAPS - i) % HILBERT_TAPS];
+		double re = ch->hist[(ch->hist_idx + HILBERT_TAPS - HILBERT_TAPS / 2) % HILBERT_TAPS];
+		ch->hist_idx = (ch->hist_idx + 1) % HILBERT_TAPS;
+
+		x = re * cos(ch->phase) - im * sin(ch->phase);
+		ch->phase = fmod(ch->phase + 2 * M_PI * ch->offset / SAMPLERATE, 2 * M_PI);
+	}
+
+	/* Clock drift: the receiver takes (1 + drift) samples for every one sent */
+	if (!ch->drift)
+	{
+		rx_put(x);
+		return;
+	}
+	memmove(ch->rs, ch->rs + 1, sizeof(ch->rs) - sizeof(ch->rs[0]));
+	ch->rs[3] = x;
+	while (ch->rs_pos < 1)
+	{
+		rx_put(interp(ch->rs, ch->rs_pos));
+		ch->rs_pos += 1 / (1 + ch->drift);
+	}
+	ch->rs_pos -= 1;
+}
+
+/*
+ * A sample of the modulator, at CONFIG_AFSK_DAC_SAMPLERATE.
+ * The DAC holds it until the next one: the channel takes the sample
+ * being held at every ADC sample.
+ */
+static void tx_put(uint8_t s)
+{
+	tx_clock += SAMPLERATE;
+	if (tx_clock >= CONFIG_AFSK_DAC_SAMPLERATE)
+	{
+		tx_clock -= CONFIG_AFSK_DAC_SAMPLERATE;
+		channel_put(&chan, (int8_t)(s - 128) * TONE_AMPL / 128);
+	}
+}
+
+static void message_hook(struct AX25View *frm)
+{
+	unsigned idx;
+
+	if (frm->addr_cnt && sscanf((const char *)frm->info, ">afsksim %u", &idx) == 1 && idx < nframes)
+		received[idx] = true;
+}
+
+static void au_open(const char *name)
+{
+	static const uint8_t hdr[24] =
+	{
+		'.', 's', 'n', 'd', 0, 0, 0, 24, 0xff, 0xff, 0xff, 0xff, 0, 0, 0, 2,
+		(SAMPLERATE >> 24) & 0xff, (SAMPLERATE >> 16) & 0xff,
+		(SAMPLERATE >> 8) & 0xff, SAMPLERATE & 0xff, 0, 0, 0, 1
+	};
+
+	au_out = fopen(name, "wb");
+	if (!au_out || fwrite(hdr, 1, sizeof(hdr), au_out) != sizeof(hdr))
+	{
+		perror(name);
+		exit(1);
+	}
+	au_len = 0;
+}
+
+static void au_close(void)
+{
+	uint32_t len = cpu_to_be32(au_len);
+
+	fseek(au_out, 8, SEEK_SET);
+	fwrite(&len, 1, sizeof(len), au_out);
+	fclose(au_out);
+	au_out = NULL;
+}
+
+/**
+ * Send nframes frames through the channel.
+ * \return the number of frames decoded.
+ */
+static unsigned run(double snr, unsigned seed)
+{
+	char info[128];
+
+	srand(seed);
+	afsk_init(&tx, 0, 0);
+	afsk_setTiming(&tx, txdelay, CONFIG_AFSK_TRAILER_LEN);
+	ax25_init(&tx_ax25, &tx.fd, NULL);
+	afsk_init(&rx, 0, 0);
+	ax25_init(&rx_ax25, &rx.fd, message_hook);
+	if (agc)
+	{
+		kfile_init(&pot.fd);
+		pot.fd.write = mcp41_write;
+		pot.cmd = false;
+		agc_init(&rx, &pot.fd);
+		agc_set_gain(agc_start);
+	}
+	channel_init(&chan);
+	chan.noise = TONE_AMPL / sqrt(2 * pow(10, snr / 10));
+	rx_samples = 0;
+	tx_clock = 0;
+	memset(received, 0, sizeof(received));
+	gap_samples = 0;
+	dcd_delay = dcd_air = dcd_lost = dcd_noise = dcd_false = 0;
+
+	for (unsigned f = 0; f < nframes; f++)
+	{
+		/* Random payload length and content after the frame number */
+		int len = snprintf(info, sizeof(info), ">afsksim %u ", f);
+		int extra = rand() % (int)(sizeof(info) - len);
+		for (int i = 0; i < extra; i++)
+			info[len++] = ' ' + rand() % 95;
+
+		ax25_send(&tx_ax25, AX25_CALL("apzsim", 0), AX25_CALL("n0call", 1), info, len);
+		on_air = true;
+		dcd_asserted = false;
+		do
+			tx_put(afsk_dac_isr(&tx));
+		while (tx.sending);
+		on_air = false;
+
+		for (int i = rand() % MAX_GAP; i >= 0; i--)
+			channel_put(&chan, 0);
+	}
+
+	/* Flush the channel and the receiver */
+	for (int i = 0; i < SAMPLERATE / 10; i++)
+		channel_put(&chan, 0);
+	ax25_poll(&rx_ax25);
+
+	unsigned ok = 0;
+	for (unsigned f = 0; f < nframes; f++)
+		ok += received[f];
+	return ok;
+}
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"Usage: afsksim [-n frames] [-s snr|from:to:step] [-t twist_db]\n"
+		"               [-f offset_hz] [-d drift_ppm] [-c clip] [-p txdelay_ms]\n"
+		"               [-g level_db] [-a agc_gain] [-r seed] [-w file.au]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	double snr_from = 20, snr_to = 0, snr_step = -2;
+	unsigned seed = 1;
+	double level_db = 0;
+	const char *au_name = NULL;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const char *opt = argv[i];
+		const char *arg = (i + 1 < argc) ? argv[++i] : NULL;
+
+		if (strlen(opt) != 2 || opt[0] != '-' || !arg)
+			usage();
+
+		switch (opt[1])
+		{
+		case 'n':
+			nframes = MIN(atoi(arg), MAX_FRAMES);
+			break;
+		case 's':
+			if (sscanf(arg, "%lf:%lf:%lf", &snr_from, &snr_to, &snr_step) != 3)
+			{
+				snr_from = snr_to = atof(arg);
+				snr_step = -1;
+			}
+			break;
+		case 't':
+			chan.twist = atof(arg);
+			break;
+		case 'f':
+			chan.offset = atof(arg);
+			break;
+		case 'd':
+			chan.drift = atof(arg) * 1e-6;
+			break;
+		case 'c':
+			chan.clip = atof(arg);
+			break;
+		case 'p':
+			txdelay = atoi(arg);
+			break;
+		case 'g':
+			level_db = atof(arg);
+			break;
+		case 'a':
+			agc = true;
+			agc_start = MIN(atoi(arg), MCP41_MAX);
+			break;
+		case 'r':
+			seed = atoi(arg);
+			break;
+		case 'w':
+			au_name = arg;
+			break;
+		default:
+			usage();
+		}
+	}
+
+	if (!snr_step || (snr_to - snr_from) * snr_step < 0
+		|| fabs(chan.twist) > EMPH_STAGES * EMPH_MAX_TWIST)
+		usage();
+
+	chan.level = pow(10, level_db / 20);
+
+	printf("# twist %+.1fdB, offset %+.1fHz, drift %+.0fppm, clip %.2f, txdelay %ums, %u frames\n",
+		chan.twist, chan.offset, chan.drift * 1e6, chan.clip, txdelay, nframes);
+	printf("# level %+.1fdB", level_db);
+	if (agc)
+		printf(", agc from %u/%u", agc_start, MCP41_MAX);
+	printf("\n# snr_db  decoded  rate  dcd_ms  dcd_lost  dcd_false%s", agc ? "  agc_gain" : "");
+#if CONFIG_AFSK_ENSEMBLE
+	printf("  dups  by_demod");
+#endif
+	putchar('\n');
+
+	for (double snr = snr_from;
+		snr_step > 0 ? snr <= snr_to + 1e-9 : snr >= snr_to - 1e-9;
+		snr += snr_step)
+	{
+		if (au_name)
+			au_open(au_name);
+
+		unsigned ok = run(snr, seed);
+		printf("%8.1f  %7u  %5.1f%%  %6.1f  %7.2f%%  %8.2f%%", snr, ok, 100.0 * ok / MAX(nframes, 1U),
+			1000.0 * dcd_delay / SAMPLERATE / MAX(nframes, 1U),
+			100.0 * dcd_lost / MAX(dcd_air, 1UL), 100.0 * dcd_false / MAX(dcd_noise, 1UL));
+		if (agc)
+			printf("  %8u", agc_get_gain());
+#if CONFIG_AFSK_ENSEMBLE
+		AfskEnsembleStats ens;
+		afsk_rxEnsemble(&rx, &ens);
+		printf("  %4u ", ens.dups);
+		for (int i = 0; i < CONFIG_AFSK_ENSEMBLE; i++)
+			printf("%c%u", i ? '/' : ' ', ens.frames[i]);
+#endif
+		putchar('\n');
+		fflush(stdout);
+
+		if (au_name)
+		{
+			au_close();
+			au_name = NULL;
+		}
+	}
+	return 0;
+}
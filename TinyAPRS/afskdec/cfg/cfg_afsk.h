@@ -0,0 +1,54 @@
+/*
+ * \file cfg_afsk.h
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * -->
+ *
+ * \brief AFSK configuration for the host decoder.
+ *
+ * Same settings as the firmware, except for the discriminator filter,
+ * the ensemble and the frame repair, which are chosen by afskdec.mk so
+ * that every variant can be built, for the size of the tx buffer and for
+ * the level meter.
+ */
+
+#ifndef AFSKDEC_CFG_AFSK_H
+#define AFSKDEC_CFG_AFSK_H
+
+#include "../../TinyAPRS/cfg/cfg_afsk.h"
+
+#ifdef AFSKDEC_FILTER
+	#undef CONFIG_AFSK_FILTER
+	#define CONFIG_AFSK_FILTER AFSKDEC_FILTER
+#endif
+
+#ifdef AFSKDEC_ENSEMBLE
+	#undef CONFIG_AFSK_ENSEMBLE
+	#define CONFIG_AFSK_ENSEMBLE AFSKDEC_ENSEMBLE
+	/* The frame repair works with a single demodulator only */
+	#undef CONFIG_AFSK_RX_REPAIR
+	#define CONFIG_AFSK_RX_REPAIR 0
+#endif
+
+#ifdef AFSKDEC_REPAIR
+	#undef CONFIG_AFSK_RX_REPAIR
+	#define CONFIG_AFSK_RX_REPAIR AFSKDEC_REPAIR
+#endif
+
+/*
+ * afsksim writes whole frames before running the modulator:
+ * nothing drains the tx buffer while ax25_send() is running.
+ */
+#undef CONFIG_AFSK_TX_BUFLEN
+#define CONFIG_AFSK_TX_BUFLEN 2048
+
+/*
+ * The level meter does not change the decoding: always on, for the
+ * afskdec summary and for the AGC of afsksim.
+ */
+#undef CONFIG_AFSK_RX_LEVEL
+#define CONFIG_AFSK_RX_LEVEL 1
+
+#endif /* AFSKDEC_CFG_AFSK_H */
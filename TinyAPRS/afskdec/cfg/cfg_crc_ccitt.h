@@ -0,0 +1,25 @@
+/*
+ * \file cfg_crc_ccitt.h
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * -->
+ *
+ * \brief CRC-CCITT configuration for the host tools.
+ *
+ * Same method as the firmware, unless afskdec.mk chooses one for
+ * crccheck.
+ */
+
+#ifndef AFSKDEC_CFG_CRC_CCITT_H
+#define AFSKDEC_CFG_CRC_CCITT_H
+
+#include "../../TinyAPRS/cfg/cfg_crc_ccitt.h"
+
+#ifdef CRCCHECK_METHOD
+	#undef CONFIG_CRC_CCITT_METHOD
+	#define CONFIG_CRC_CCITT_METHOD CRCCHECK_METHOD
+#endif
+
+#endif /* AFSKDEC_CFG_CRC_CCITT_H */
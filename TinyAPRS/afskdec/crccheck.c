@@ -0,0 +1,126 @@
+/*
+ * \file crccheck.c
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * -->
+ *
+ * \brief Host check and benchmark of the CRC-CCITT methods.
+ *
+ * One executable for every CONFIG_CRC_CCITT_METHOD, see afskdec.mk.
+ * updcrc_ccitt() and crc_ccitt() are checked against crc_ccitt_bit(),
+ * the straight bit serial CRC, on random buffers of every length up to
+ * the longest frame and every alignment; a buffer split in two calls of
+ * crc_ccitt() must give the same CRC. The time per octet of both is
+ * printed, on frames of CONFIG_AX25_FRAME_BUF_LEN octets.
+ *
+ * Usage: crccheck [-n octets] [-r seed]
+ */
+
+#include <algo/crc_ccitt.h>
+#include "cfg/cfg_ax25.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static const char *method_name[] =
+{
+	[CRC_CCITT_BIT] = "bit",
+	[CRC_CCITT_NIBBLE] = "nibble",
+	[CRC_CCITT_BYTE] = "byte",
+	[CRC_CCITT_SLICE4] = "slice4",
+	[CRC_CCITT_SLICE8] = "slice8",
+};
+
+static uint16_t ref_crc(uint16_t crc, const uint8_t *buf, size_t len)
+{
+	while (len--)
+	{
+		uint8_t c = *buf++;
+		for (int i = 0; i < 8; i++, c >>= 1)
+			crc = crc_ccitt_bit(crc, c & 1);
+	}
+	return crc;
+}
+
+static double elapsed(clock_t start, unsigned long n)
+{
+	return 1e9 * (clock() - start) / CLOCKS_PER_SEC / n;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long n = 100000000;
+	unsigned seed = 1;
+	int err = 0;
+	enum { FRAME = CONFIG_AX25_FRAME_BUF_LEN };
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (i + 1 < argc && !strcmp(argv[i], "-n"))
+			n = strtoul(argv[++i], NULL, 0);
+		else if (i + 1 < argc && !strcmp(argv[i], "-r"))
+			seed = atoi(argv[++i]);
+		else
+		{
+			fprintf(stderr, "Usage: crccheck [-n octets] [-r seed]\n");
+			return 2;
+		}
+	}
+
+	static uint8_t buf[FRAME + 8];
+	srand(seed);
+	for (size_t i = 0; i < sizeof(buf); i++)
+		buf[i] = rand();
+
+	/* Same check value as algo/crc_test.c */
+	if (crc_ccitt(CRC_CCITT_INIT_VAL, "123456789", 9) != 0x6F91)
+		err++;
+
+	for (size_t off = 0; off < 8; off++)
+		for (size_t len = 0; len <= FRAME; len++)
+		{
+			const uint8_t *p = buf + off;
+			uint16_t ref = ref_crc(CRC_CCITT_INIT_VAL, p, len);
+			uint16_t crc = CRC_CCITT_INIT_VAL;
+			size_t split = len ? (size_t)rand() % len : 0;
+
+			for (size_t i = 0; i < len; i++)
+				crc = updcrc_ccitt(p[i], crc);
+			if (crc != ref)
+				err++;
+			if (crc_ccitt(CRC_CCITT_INIT_VAL, p, len) != ref)
+				err++;
+			crc = crc_ccitt(CRC_CCITT_INIT_VAL, p, split);
+			if (crc_ccitt(crc, p + split, len - split) != ref)
+				err++;
+		}
+
+	/* The sums keep the compiler from dropping the loops */
+	unsigned long frames = (n + FRAME - 1) / FRAME;
+	unsigned long sum = 0;
+
+	clock_t start = clock();
+	for (unsigned long f = 0; f < frames; f++)
+		sum += crc_ccitt(CRC_CCITT_INIT_VAL, buf + (f & 7), FRAME);
+	double bulk = elapsed(start, frames * FRAME);
+
+	start = clock();
+	for (unsigned long f = 0; f < frames; f++)
+	{
+		uint16_t crc = CRC_CCITT_INIT_VAL;
+		for (size_t i = 0; i < FRAME; i++)
+			crc = updcrc_ccitt(buf[(f & 7) + i], crc);
+		sum += crc;
+	}
+	double octet = elapsed(start, frames * FRAME);
+
+	printf("%-8s %s, %.2f ns/octet crc_ccitt(), %.2f ns/octet updcrc_ccitt() [%lX]\n",
+		method_name[CONFIG_CRC_CCITT_METHOD], err ? "MISMATCH" : "bit exact",
+		bulk, octet, sum);
+
+	return err ? 1 : 0;
+}
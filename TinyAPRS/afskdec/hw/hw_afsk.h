@@ -0,0 +1,34 @@
+/*
+ * \file hw_afsk.h
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * -->
+ *
+ * \brief AFSK modem hardware definitions for the host decoder.
+ *
+ * There is no hardware: samples are fed to afsk_adc_isr() by afskdec.c
+ * and nothing is ever transmitted.
+ */
+
+#ifndef HW_AFSK_H
+#define HW_AFSK_H
+
+#define AFSK_ADC_INIT(ch, ctx)   do { (void)ch, (void)ctx; } while (0)
+
+#define AFSK_STROBE_INIT() do { } while (0)
+#define AFSK_STROBE_ON()   do { } while (0)
+#define AFSK_STROBE_OFF()  do { } while (0)
+
+#define AFSK_LED_INIT()    do { } while (0)
+#define AFSK_LED_TX_ON()   do { } while (0)
+#define AFSK_LED_TX_OFF()  do { } while (0)
+#define AFSK_LED_RX_ON()   do { } while (0)
+#define AFSK_LED_RX_OFF()  do { } while (0)
+
+#define AFSK_DAC_INIT(ch, ctx)   do { (void)ch, (void)ctx; } while (0)
+#define AFSK_DAC_IRQ_START(ch)   do { (void)ch; } while (0)
+#define AFSK_DAC_IRQ_STOP(ch)    do { (void)ch; } while (0)
+
+#endif /* HW_AFSK_H */
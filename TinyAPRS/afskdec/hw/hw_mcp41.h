@@ -0,0 +1,26 @@
+/*
+ * \file hw_mcp41.h
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * -->
+ *
+ * \brief MCP41 hardware definitions for the host simulator.
+ *
+ * There is no chip select: afsksim.c models the potentiometer behind
+ * the SPI KFile given to mcp41_init(), one command is two bytes.
+ */
+
+#ifndef HW_MCP41_H
+#define HW_MCP41_H
+
+#include "hw/mcp41_map.h"
+
+#include <cfg/compiler.h>
+
+INLINE void SET_MCP41_DDR(Mcp41Dev dev) { (void)dev; }
+INLINE void MCP41_ON(Mcp41Dev dev) { (void)dev; }
+INLINE void MCP41_OFF(Mcp41Dev dev) { (void)dev; }
+
+#endif /* HW_MCP41_H */
@@ -0,0 +1,157 @@
+/*
+ * \file repaircheck.c
+ * <!--
+ * This file is part of TinyAPRS.
+ * Released under GPL License
+ *
+ * -->
+ *
+ * \brief Host check of the repair of the received frames.
+ *
+ * Random frames with a good FCS have one or two tones flipped, then are
+ * queued in the modem as the demodulator does, with the flipped tones
+ * among the ones that can be repaired. afsk_rxFrame() must return the
+ * original frame. It is called again before afsk_rxFrameDone(), once on
+ * the frame as returned and once on the frame changed in place, as the
+ * digipeater does: the frame must come back the same, and be counted
+ * only once in Afsk.repaired. A frame whose flipped tone is not among
+ * the kept ones must be dropped as a CRC error.
+ *
+ * afsk.c is included, the queue of the received frames is static.
+ *
+ * Usage: repaircheck [-n frames] [-r seed]
+ */
+
+#include <net/afsk.c>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !CONFIG_AFSK_RX_REPAIR
+	#error "repaircheck needs CONFIG_AFSK_RX_REPAIR"
+#endif
+
+#define MIN_LEN 18 /* addresses, control, PID and FCS */
+
+static Afsk afsk;
+
+/** Queue \a len bytes of \a data, as the demodulator does with a bad CRC */
+static void queue_frame(const uint8_t *data, uint16_t len, const uint16_t *pos, uint8_t cnt)
+{
+	AfskRxFrame *frm = &afsk.rx_frames[afsk.rx_head];
+
+	memcpy(afsk.rx_buf, data, len);
+	frm->start = 0;
+	frm->len = len;
+	frm->crc = crc_ccitt(CRC_CCITT_INIT_VAL, data, len);
+	frm->rep_cnt = cnt;
+	memcpy(frm->rep_pos, pos, cnt * sizeof(*pos));
+	afsk.rx_cnt = 1;
+}
+
+static void flip_tone(uint8_t *data, uint16_t pos)
+{
+	data[pos / 8] ^= BV(pos % 8);
+	pos++;
+	data[pos / 8] ^= BV(pos % 8);
+}
+
+/** \return true if afsk_rxFrame() returns \a len bytes equal to \a ref */
+static bool frame_is(const uint8_t *ref, size_t len)
+{
+	size_t l, size;
+	uint8_t *frm = afsk_rxFrame(&afsk, &l, &size);
+
+	return frm && l == len && !memcmp(frm, ref, len);
+}
+
+/** \return the number of failures on one random frame with \a errs flipped tones */
+static int check_frame(int errs)
+{
+	uint8_t good[CONFIG_AFSK_RX_BUFLEN];
+	uint8_t bad[CONFIG_AFSK_RX_BUFLEN];
+	uint16_t len = MIN_LEN + rand() % (sizeof(good) - CONFIG_AFSK_RX_ROOM - MIN_LEN + 1);
+	uint16_t pos[2];
+	int fail = 0;
+
+	for (uint16_t i = 0; i < len - 2; i++)
+		good[i] = rand();
+	uint16_t fcs = ~crc_ccitt(CRC_CCITT_INIT_VAL, good, len - 2);
+	good[len - 2] = fcs & 0xff;
+	good[len - 1] = fcs >> 8;
+
+	memcpy(bad, good, len);
+	for (int i = 0; i < errs; i++)
+	{
+		/* Both the bits of a tone in the frame, the tones apart */
+		do
+			pos[i] = rand() % (len * 8 - 1);
+		while (i && (uint16_t)(pos[i] - pos[0] + 1) <= 2);
+		flip_tone(bad, pos[i]);
+	}
+
+	unsigned repaired = afsk.repaired;
+	queue_frame(bad, len, pos, errs);
+	if (!frame_is(good, len))
+		fail++;
+	if (!frame_is(good, len))
+		fail++;
+
+	/* Changed in place: no more repairs on it */
+	afsk.rx_buf[pos[0] / 8] ^= 0x5a;
+	good[pos[0] / 8] ^= 0x5a;
+	if (!frame_is(good, len))
+		fail++;
+	if (afsk.repaired != repaired + 1)
+		fail++;
+	afsk_rxFrameDone(&afsk);
+
+	/* The kept tone is not the flipped one */
+	uint16_t crc_errors = afsk.crc_errors;
+	pos[0] = (pos[0] + 8) % (len * 8 - 1);
+	queue_frame(bad, len, pos, 1);
+	size_t l, size;
+	if (afsk_rxFrame(&afsk, &l, &size) || afsk.rx_cnt || afsk.crc_errors != crc_errors + 1)
+		fail++;
+
+	return fail;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long n = 10000;
+	unsigned seed = 1;
+	int err = 0;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (i + 1 < argc && !strcmp(argv[i], "-n"))
+			n = strtoul(argv[++i], NULL, 0);
+		else if (i + 1 < argc && !strcmp(argv[i], "-r"))
+			seed = atoi(argv[++i]);
+		else
+		{
+			fprintf(stderr, "Usage: repaircheck [-n frames] [-r seed]\n");
+			return 2;
+		}
+	}
+
+	afsk_init(&afsk, 0, 0);
+	srand(seed);
+	for (int errs = 1; errs <= CONFIG_AFSK_RX_REPAIR; errs++)
+	{
+		unsigned long fail = 0;
+
+		for (unsigned long i = 0; i < n; i++)
+			fail += check_frame(errs) != 0;
+		printf("%d tone%s flipped, %lu frames: %s\n", errs, errs > 1 ? "s" : "",
+			n, fail ? "FAILED" : "repaired once");
+		if (fail)
+		{
+			printf("  %lu frames failed\n", fail);
+			err = 1;
+		}
+	}
+	return err;
+}
@@ -37,6 +37,19 @@
 
 #include "crc_ccitt.h"
 
+#if CONFIG_CRC_CCITT_METHOD < CRC_CCITT_BIT || CONFIG_CRC_CCITT_METHOD > CRC_CCITT_SLICE8
+	#error "Unknown CONFIG_CRC_CCITT_METHOD"
+#endif
+
+#if CONFIG_CRC_CCITT_METHOD == CRC_CCITT_NIBBLE
+
+const uint16_t crc_ccitt_nibble[16] = {
+	0x0000, 0x1081, 0x2102, 0x3183, 0x4204, 0x5285, 0x6306, 0x7387,
+	0x8408, 0x9489, 0xa50a, 0xb58b, 0xc60c, 0xd68d, 0xe70e, 0xf78f,
+};
+
+#elif CONFIG_CRC_CCITT_METHOD >= CRC_CCITT_BYTE
+
 const uint16_t PROGMEM crc_ccitt_tab[256] = {
 	0x0000, 0x1189, 0x2312, 0x329b, 0x4624, 0x57ad, 0x6536, 0x74bf,
 	0x8c48, 0x9dc1, 0xaf5a, 0xbed3, 0xca6c, 0xdbe5, 0xe97e, 0xf8f7,
@@ -72,6 +85,72 @@ const uint16_t PROGMEM crc_ccitt_tab[256] = {
 	0x7bc7, 0x6a4e, 0x58d5, 0x495c, 0x3de3, 0x2c6a, 0x1ef1, 0x0f78,
 };
 
+#endif
+
+#if CONFIG_CRC_CCITT_METHOD >= CRC_CCITT_SLICE4
+
+#if CONFIG_CRC_CCITT_METHOD == CRC_CCITT_SLICE8
+	#define CRC_SLICES 8
+#else
+	#define CRC_SLICES 4
+#endif
+
+/*
+ * crc_slice[k - 1][c] is the CRC, from 0, of the octet c followed by
+ * k zero octets: the byte table is the one for k = 0.
+ */
+static uint16_t crc_slice[CRC_SLICES - 1][256];
+static bool crc_slice_ready;
+
+static void crc_sliceInit(void)
+{
+	for (unsigned c = 0; c < 256; c++)
+	{
+		uint16_t crc = pgm_read16(&crc_ccitt_tab[c]);
+
+		for (unsigned k = 0; k < CRC_SLICES - 1; k++)
+		{
+			crc = updcrc_ccitt(0, crc);
+			crc_slice[k][c] = crc;
+		}
+	}
+	crc_slice_ready = true;
+}
+
+/*
+ * The CRC fits in the first two octets of a slice: they are mixed with
+ * it, the others start from 0. The slice CRC is the sum of the CRC of
+ * every octet followed by the rest of the slice.
+ */
+uint16_t crc_ccitt(uint16_t crc, const void *buffer, size_t len)
+{
+	const unsigned char *buf = (const unsigned char *)buffer;
+
+	if (!crc_slice_ready)
+		crc_sliceInit();
+
+	for (; len >= CRC_SLICES; len -= CRC_SLICES, buf += CRC_SLICES)
+	{
+		crc ^= buf[0] | (buf[1] << 8);
+	#if CRC_SLICES == 8
+		crc = crc_slice[6][crc & 0xff] ^ crc_slice[5][crc >> 8]
+			^ crc_slice[4][buf[2]] ^ crc_slice[3][buf[3]]
+			^ crc_slice[2][buf[4]] ^ crc_slice[1][buf[5]]
+			^ crc_slice[0][buf[6]] ^ pgm_read16(&crc_ccitt_tab[buf[7]]);
+	#else
+		crc = crc_slice[2][crc & 0xff] ^ crc_slice[1][crc >> 8]
+			^ crc_slice[0][buf[2]] ^ pgm_read16(&crc_ccitt_tab[buf[3]]);
+	#endif
+	}
+
+	while (len--)
+		crc = updcrc_ccitt(*buf++, crc);
+
+	return crc;
+}
+
+#else
+
 uint16_t crc_ccitt(uint16_t crc, const void *buffer, size_t len)
 {
 	const unsigned char *buf = (const unsigned char *)buffer;
@@ -81,3 +160,4 @@ uint16_t crc_ccitt(uint16_t crc, const void *buffer, size_t len)
 	return crc;
 }
 
+#endif
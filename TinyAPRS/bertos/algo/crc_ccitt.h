@@ -34,19 +34,73 @@
  *
  * \note This algorithm is incompatible with the CRC16.
  *
+ * The method is chosen by CONFIG_CRC_CCITT_METHOD:
+ *  - CRC_CCITT_BIT: bit serial, crc_ccitt_bit() can be fused in a
+ *    HDLC deframer to compute the CRC as the bits come;
+ *  - CRC_CCITT_NIBBLE: two lookups per byte in a 16 entries RAM table;
+ *  - CRC_CCITT_BYTE: one lookup per byte in the 256 entries table kept
+ *    in program memory;
+ *  - CRC_CCITT_SLICE4, CRC_CCITT_SLICE8: same as CRC_CCITT_BYTE one byte
+ *    at a time, crc_ccitt() takes 4 or 8 bytes per step with more tables
+ *    built in RAM.
+ * All of them give the same results.
+ *
  * \author Francesco Sacchi <batt@develer.com>
  *
  * $WIZ$ module_name = "crc-ccitt"
+ * $WIZ$ module_configuration = "bertos/cfg/cfg_crc_ccitt.h"
  */
 
 #ifndef ALGO_CRC_CCITT_H
 #define ALGO_CRC_CCITT_H
 
+#include "cfg/cfg_crc_ccitt.h"
+
 #include <cfg/compiler.h>
 #include <cpu/pgm.h>
 
 EXTERN_C_BEGIN
 
+/** CRC-CCITT polynomial, bit reversed */
+#define CRC_CCITT_POLY 0x8408
+
+/**
+ * \brief Compute the updated CRC-CCITT value for one bit, the least
+ * significant bit of the octets comes first.
+ */
+INLINE uint16_t crc_ccitt_bit(uint16_t crc, bool bit)
+{
+	bool fb = (crc ^ bit) & 1;
+
+	crc >>= 1;
+	if (fb)
+		crc ^= CRC_CCITT_POLY;
+	return crc;
+}
+
+#if CONFIG_CRC_CCITT_METHOD == CRC_CCITT_BIT
+
+INLINE uint16_t updcrc_ccitt(uint8_t c, uint16_t oldcrc)
+{
+	for (uint8_t i = 0; i < 8; i++, c >>= 1)
+		oldcrc = crc_ccitt_bit(oldcrc, c & 1);
+	return oldcrc;
+}
+
+#elif CONFIG_CRC_CCITT_METHOD == CRC_CCITT_NIBBLE
+
+/* CRC of the nibbles, in RAM */
+extern const uint16_t crc_ccitt_nibble[16];
+
+INLINE uint16_t updcrc_ccitt(uint8_t c, uint16_t oldcrc)
+{
+	oldcrc ^= c;
+	oldcrc = (oldcrc >> 4) ^ crc_ccitt_nibble[oldcrc & 0x0f];
+	return (oldcrc >> 4) ^ crc_ccitt_nibble[oldcrc & 0x0f];
+}
+
+#else
+
 /* CRC table */
 extern const uint16_t crc_ccitt_tab[256];
 
@@ -58,6 +112,8 @@ INLINE uint16_t updcrc_ccitt(uint8_t c, uint16_t oldcrc)
 	return (oldcrc >> 8) ^ pgm_read16(&crc_ccitt_tab[(oldcrc ^ c) & 0xff]);
 }
 
+#endif
+
 /** CRC-CCITT init value */
 #define CRC_CCITT_INIT_VAL ((uint16_t)0xFFFF)
 
@@ -64,6 +64,30 @@ int crc_testRun(void)
 	kprintf("crc_ccitt [%04X]\n", crc);
 	ASSERT(crc == 0x6F91);
 
+	/*
+	 * The method chosen by CONFIG_CRC_CCITT_METHOD against the bit serial
+	 * CRC, on every length and alignment.
+	 */
+	uint8_t buf[64 + 8];
+	for (size_t i = 0; i < sizeof(buf); i++)
+		buf[i] = i * 151 + 7;
+
+	for (size_t off = 0; off < 8; off++)
+		for (size_t len = 0; len <= 64; len++)
+		{
+			uint16_t ref = CRC_CCITT_INIT_VAL;
+			uint16_t oct = CRC_CCITT_INIT_VAL;
+
+			for (size_t i = 0; i < len; i++)
+			{
+				for (int b = 0; b < 8; b++)
+					ref = crc_ccitt_bit(ref, (buf[off + i] >> b) & 1);
+				oct = updcrc_ccitt(buf[off + i], oct);
+			}
+			ASSERT(oct == ref);
+			ASSERT(crc_ccitt(CRC_CCITT_INIT_VAL, buf + off, len) == ref);
+		}
+
 	crc = CRC16_INIT_VAL;
 	crc = crc16(crc, vector, sizeof(vector));
 	kprintf("crc16 [%04X]\n", crc);
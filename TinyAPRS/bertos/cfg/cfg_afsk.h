@@ -71,15 +71,141 @@
  */
 #define CONFIG_AFSK_FILTER AFSK_CHEBYSHEV
 
+/**
+ * Number of demodulators run in parallel on every sample (ensemble mode).
+ * Each demodulator uses a different filter/slicer combination, frames
+ * decoded by more than one of them are delivered only once.
+ * Needs CONFIG_AFSK_RX_FRAMES. Every demodulator needs
+ * CONFIG_AFSK_ENSEMBLE_FRAME_LEN bytes of RAM, too many for an ATmega328P:
+ * the mode is for the host tools (afsksim_ensemble) and bigger CPUs.
+ * Set to 0 to run the single demodulator selected by CONFIG_AFSK_FILTER.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ * $WIZ$ max = 4
+ */
+#define CONFIG_AFSK_ENSEMBLE 0
+
+/**
+ * Longest frame accepted by an ensemble demodulator.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 18
+ */
+#define CONFIG_AFSK_ENSEMBLE_FRAME_LEN 330
+
+/**
+ * Number of recently delivered frames remembered for duplicate suppression.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ */
+#define CONFIG_AFSK_ENSEMBLE_DEDUP 4
+
+
+/**
+ * Number of complete frames the receiver can queue.
+ * When enabled, the demodulator checks the CRC and stores the good
+ * frames unescaped in the rx buffer, afsk_rxFrame() hands them over in
+ * place and afsk_read() copies one whole frame per call (enable
+ * CONFIG_AX25_FRAMED_RX too).
+ * Set to 0 to stream the escaped bitstream characters instead.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ */
+#define CONFIG_AFSK_RX_FRAMES 0
 
 /**
  * AFSK receiver buffer length.
+ * With CONFIG_AFSK_RX_FRAMES it must hold at least a whole frame and
+ * CONFIG_AFSK_RX_ROOM; the frames are handed over in place, there is no
+ * other copy of them (see CONFIG_AX25_FRAMED_RX).
  *
  * $WIZ$ type = "int"
  * $WIZ$ min = 2
  */
 #define CONFIG_AFSK_RX_BUFLEN 32
 
+/**
+ * Free bytes kept after every received frame with CONFIG_AFSK_RX_FRAMES,
+ * so that the frame can grow in place (the digipeater inserts its 7 byte
+ * address in the path).
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ */
+#define CONFIG_AFSK_RX_ROOM 0
+
+/**
+ * Repair of the frames with a bad CRC, max number of tones flipped.
+ * The demodulator keeps the least confident tones of every frame, a
+ * frame with a bad CRC received with a locked bit clock is queued with
+ * them and afsk_rxFrame() tries to flip up to this number of them.
+ * Needs CONFIG_AFSK_RX_FRAMES and no ensemble, 0 to disable.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ * $WIZ$ max = 2
+ */
+#define CONFIG_AFSK_RX_REPAIR 0
+
+/**
+ * Number of least confident tones kept for the repair of a frame.
+ * Each one costs a CRC pass over the frame in afsk_rxFrame().
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ * $WIZ$ max = 16
+ */
+#define CONFIG_AFSK_RX_REPAIR_BITS 6
+
+/**
+ * Receive equalizer.
+ * While the bit clock is locked, from the preamble on, the demodulator
+ * measures its output on the mark and space tones and moves the slicer
+ * towards their midpoint, following the twist of the receiver and the
+ * tone offset of the transmitter. The FIR demodulator also levels its
+ * 1200Hz and 2200Hz bands. The estimates are shown by the console info
+ * and by the KISS stats command.
+ *
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_AFSK_RX_EQ 0
+
+/**
+ * Receive audio level meter.
+ * The ADC ISR measures the DC offset, the RMS and the peak of the input
+ * and counts the clipped samples, the demodulator the mark and space
+ * levels of the last decoded frame. Shown by the AT+LEVEL command and by
+ * the KISS stats command, to set the receive audio level.
+ *
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_AFSK_RX_LEVEL 0
+
+/**
+ * Data carrier detect hold-over, in [ms].
+ * The carrier detect, afsk_dcd(), is asserted as soon as the bit clock
+ * locks on a signal or two HDLC flags are received in a row, and released
+ * this long after the signal is lost; it bridges short fades. Used by the
+ * channel access of KISS, of the digipeater and of the beacons.
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ * $WIZ$ max = 200
+ */
+#define CONFIG_AFSK_DCD_HOLD 20
+
+/**
+ * AVR assembly for the feedback multiply of the IIR discriminators, a
+ * 16x8 bit multiply instead of the 32 bit one of the C code. The results
+ * are the same, see afskdec/afskcheck.c; the other CPUs run a C model of
+ * the assembly.
+ *
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_AFSK_RX_ASM 0
+
 /**
  * AFSK transimtter buffer length.
  *
@@ -88,13 +214,56 @@
  */
 #define CONFIG_AFSK_TX_BUFLEN 32
 
+/**
+ * Encode the transmitted characters in the caller context.
+ * Bit stuffing and NRZI are applied by afsk_write(), the tx buffer
+ * holds the tones to be sent, so the DAC ISR only has to shift them out.
+ *
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_AFSK_TX_PREENCODE 0
+
+/**
+ * Size of the ADC sample ring, a power of 2 up to 128, 0 to disable.
+ * When enabled the ADC ISR only stores the samples, they are demodulated
+ * in blocks by afsk_rxProcess(), called by every read of the modem
+ * (so by ax25_poll()). The main loop must poll the modem at least once
+ * every (size - SAMPLEPERBIT / 2) samples, otherwise samples are lost.
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 0
+ * $WIZ$ max = 128
+ */
+#define CONFIG_AFSK_RX_BLOCK 0
+
+/**
+ * AFSK ADC sample rate for the demodulator, a multiple of 1200.
+ * The demodulator filters are derived from it: higher rates decode
+ * better but take more CPU time.
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 7200
+ */
+#define CONFIG_AFSK_ADC_SAMPLERATE 9600
+
 /**
  * AFSK DAC sample rate for modem outout.
+ * It needs not be a multiple of 1200: higher rates give a smoother
+ * output, with more CPU time while transmitting.
+ * The 4 bit DAC of TinyAPRS runs at the ADC sample rate, the 8 bit
+ * one at 62500 divided by 2 to 255 (31250, 20833, 15625, ...).
  * $WIZ$ type = "int"
- * $WIZ$ min = 2400
+ * $WIZ$ min = 4800
  */
 #define CONFIG_AFSK_DAC_SAMPLERATE 9600
 
+/**
+ * AFSK DAC resolution in bits, the modulator wave table is computed
+ * for it at build time.
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ * $WIZ$ max = 8
+ */
+#define CONFIG_AFSK_DAC_BITS 4
+
 /**
  * AFSK RX timeout in ms, set to -1 to disable.
  * $WIZ$ type = "int"
@@ -105,6 +274,7 @@
 
 /**
  * AFSK Preamble length in [ms], before starting transmissions.
+ * This is the default, see afsk_setTiming() to change it at runtime.
  * $WIZ$ type = "int"
  * $WIZ$ min = 1
  */
@@ -114,10 +284,35 @@
 
 /**
  * AFSK Trailer length in [ms], before stopping transmissions.
+ * This is the default, see afsk_setTiming() to change it at runtime.
  * $WIZ$ type = "int"
  * $WIZ$ min = 1
  */
 #define CONFIG_AFSK_TRAILER_LEN 50UL
+
+/**
+ * Max number of frames sent with a single keyup.
+ * Frames written while the transmitter is still keyed up share its
+ * preamble, up to this number; set to 1 to key up for every frame.
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ */
+#define CONFIG_AFSK_TX_BUNDLE_FRAMES 4
+
+/**
+ * Max airtime of a single keyup in [ms], preamble included.
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 1
+ */
+#define CONFIG_AFSK_TX_BUNDLE_MS 2000UL
+
+/**
+ * Measure the time spent in the modem ISR, for the receive and the
+ * transmit paths: min/avg/max cycles and overruns, see hw_afsk_isrCycles().
+ * Costs some cycles in the ISR itself.
+ * $WIZ$ type = "boolean"
+ */
+#define CONFIG_AFSK_ISR_STATS 0
 /**
  * Use PWM TX rather than weighted resistor DAC
  *
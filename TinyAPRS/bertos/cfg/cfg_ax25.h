@@ -56,20 +56,32 @@
 
 /**
  * AX25 frame buffer lenght.
+ * Not allocated with CONFIG_AX25_FRAMED_RX, the modem holds the frames.
  *
  * $WIZ$ type = "int"
  * $WIZ$ min = 18
  */
 #define CONFIG_AX25_FRAME_BUF_LEN 330
 
+/**
+ * Buffer on the stack for the frames sent by ax25_sendVia() and
+ * ax25_sendRaw(): every time it fills up it is written to the channel.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = 4
+ */
+#define CONFIG_AX25_TX_BUF_LEN 64
 
 /**
- * Enable repeaters listing in AX25 frames.
- * If enabled use 56 addtional bytes of RAM
- * for each message received.
+ * Read whole frames from the channel.
+ * The channel must be the AFSK modem with CONFIG_AFSK_RX_FRAMES: its
+ * frames, already CRC checked, are handed to the hook in place in the
+ * modem buffer (afsk_rxFrame()), with no copy in AX25Ctx.
+ * Disable to parse the HDLC escaped character stream of any channel.
  *
  * $WIZ$ type = "boolean"
  */
-#define CONFIG_AX25_RPT_LST 1
+#define CONFIG_AX25_FRAMED_RX 0
+
 
 #endif /* CFG_AX25_H */
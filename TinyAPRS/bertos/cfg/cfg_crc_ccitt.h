@@ -0,0 +1,61 @@
+/**
+ * \file
+ * <!--
+ * This file is part of BeRTOS.
+ *
+ * Bertos is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ * As a special exception, you may use this file as part of a free software
+ * library without restriction.  Specifically, if other files instantiate
+ * templates or use macros or inline functions from this file, or you compile
+ * this file and link it with other files to produce an executable, this
+ * file does not by itself cause the resulting executable to be covered by
+ * the GNU General Public License.  This exception does not however
+ * invalidate any other reasons why the executable file might be covered by
+ * the GNU General Public License.
+ *
+ * -->
+ *
+ * \brief Configuration file for the CRC-CCITT module.
+ */
+
+#ifndef CFG_CRC_CCITT_H
+#define CFG_CRC_CCITT_H
+
+/**
+ * \name CRC-CCITT methods.
+ * $WIZ$ crc_ccitt_method_list = "CRC_CCITT_BIT", "CRC_CCITT_NIBBLE", "CRC_CCITT_BYTE", "CRC_CCITT_SLICE4", "CRC_CCITT_SLICE8"
+ * \{
+ */
+#define CRC_CCITT_BIT     0 ///< Bit serial, no table
+#define CRC_CCITT_NIBBLE  1 ///< 16 entries table in RAM, 32 bytes
+#define CRC_CCITT_BYTE    2 ///< 256 entries table in program memory, 512 bytes
+#define CRC_CCITT_SLICE4  3 ///< Byte table, 4 bytes at a time by crc_ccitt(), 1.5KB more RAM
+#define CRC_CCITT_SLICE8  4 ///< Byte table, 8 bytes at a time by crc_ccitt(), 3.5KB more RAM
+/* \} */
+
+/**
+ * CRC-CCITT computation method.
+ * CRC_CCITT_BIT takes no memory and lets the AFSK modem compute the CRC
+ * bit by bit in its HDLC deframer, spreading the work over the bits.
+ * CRC_CCITT_NIBBLE saves the flash of the byte table, for small CPUs.
+ * The slicing methods are for the host: their tables, built on the first
+ * crc_ccitt() call, do not fit the RAM of small CPUs.
+ *
+ * $WIZ$ type = "enum"; value_list = "crc_ccitt_method_list"
+ */
+#define CONFIG_CRC_CCITT_METHOD CRC_CCITT_BYTE
+
+#endif /* CFG_CRC_CCITT_H */
@@ -107,7 +107,11 @@ int kfile_printf_P(struct KFile *fd, const char *format, ...)
 	int len;
 
 	va_start(ap, format);
+#if CPU_HARVARD
 	len = _formatted_write_P(format, (void (*)(char, void *))kfile_putc, fd, ap);
+#else
+	len = _formatted_write(format, (void (*)(char, void *))kfile_putc, fd, ap);
+#endif
 	va_end(ap);
 
 	return len;
@@ -37,6 +37,7 @@
 
 #include "afsk.h"
 #include <net/ax25.h>
+#include <algo/crc_ccitt.h>
 
 #include "cfg/cfg_afsk.h"
 #include "hw/hw_afsk.h"
@@ -53,30 +54,150 @@
 #include <cpu/pgm.h>
 #include <struct/fifobuf.h>
 
-#include <string.h> /* memset */
+#include <string.h> /* memset, memcpy */
+
+STATIC_ASSERT(!(SAMPLERATE % BITRATE));
 
 #define PHASE_BIT    8
-#define PHASE_INC    1
+/* The smallest phase correction is 1/64 of a bit, whatever the sample rate */
+#define PHASE_INC    ((SAMPLEPERBIT + 4) / 8)
 
 #define PHASE_MAX    (SAMPLEPERBIT * PHASE_BIT)
 #define PHASE_THRES  (PHASE_MAX / 2) // - PHASE_BIT / 2)
 
+/*
+ * Bit clock PLL.
+ * The edges should come at PHASE_THRES, half a bit away from the sampling
+ * point: every edge moves the phase towards it by a fraction of the error,
+ * a large one (1 / 2^PLL_ACQ_SHIFT) to acquire the clock quickly and a small
+ * one (1 / 2^PLL_TRACK_SHIFT) once locked, so that noise edges do not make
+ * the clock wander.
+ */
+#define PLL_ACQ_SHIFT   1
+#define PLL_TRACK_SHIFT 2
+
+/*
+ * Lock detection, on the average edge error (AfskDemod.pll_err, in 1/256
+ * of a bit, times 8). Random edges average 1/4 of a bit, AFSK_PLL_ERR_NOISE.
+ */
+#define PLL_LOCK_ERR    (8 * 32)
+#define PLL_UNLOCK_ERR  (8 * 48)
+/* HDLC has an edge at least every 7 bits, the lock is lost without them */
+#define PLL_MAX_BITS    8
+
+#if CONFIG_AFSK_RX_EQ
+/* The equalizer averages over 1 << EQ_SHIFT settled bits */
+#define EQ_SHIFT        4
+/* Settled bits of both tones needed to update the correction */
+#define EQ_MIN_BITS     8
+/* Lowest FIR 2200Hz band gain, 64 is 1: -12dB */
+#define EQ_GAIN_MIN     16
+#endif
+
+#if CONFIG_AFSK_RX_LEVEL
+/* The level meter window is 1 << LEVEL_SHIFT samples, about 100ms */
+#define LEVEL_SHIFT     10
+/*
+ * Delay of the slicer output on the input samples, in the middle of the
+ * range giving the right tone levels with afsksim.
+ */
+#define LEVEL_DELAY_IIR (SAMPLEPERBIT * 3 / 4)
+#define LEVEL_DELAY_FIR (SAMPLEPERBIT * 5 / 4)
+STATIC_ASSERT(LEVEL_DELAY_FIR < AFSK_LEVEL_HIST && !(AFSK_LEVEL_HIST & (AFSK_LEVEL_HIST - 1)));
+#endif
+
+/*
+ * The bit value is the majority of the last VOTE_BITS samples
+ * when the bit is sampled: 3 at 8 samples per bit.
+ */
+#define VOTE_BITS    (((SAMPLEPERBIT * 3 / 8) - 1) | 1)
+STATIC_ASSERT(VOTE_BITS < 8);
+
+/*
+ * Data carrier detect.
+ * A demodulator has a signal while its bit clock is locked, the edges
+ * being regular, or for DCD_FLAG_BITS after two HDLC flags in a row:
+ * noise gives a single flag every 256 bits, two in a row every 65536.
+ * The carrier detect is held for CONFIG_AFSK_DCD_HOLD after the last
+ * demodulator loses the signal.
+ */
+#define DCD_FLAG_BITS 16
+#define DCD_HOLD_BITS DIV_ROUND(CONFIG_AFSK_DCD_HOLD * BITRATE, 1000)
+STATIC_ASSERT(DCD_HOLD_BITS <= 255);
+
 // Modulator constants
+/*
+ * The modulator is a DDS: the phase accumulator wraps around at 2^16,
+ * its top DAC_TABLE_BITS index the full wave table. The tones are off
+ * by DAC_SAMPLERATE / 2^17 Hz at most, less than 0.1Hz at 9600Hz.
+ */
 #define MARK_FREQ  1200
-#define MARK_INC   (uint16_t)(DIV_ROUND(SIN_LEN * (uint32_t)MARK_FREQ, CONFIG_AFSK_DAC_SAMPLERATE))
+#define MARK_INC   (uint16_t)(DIV_ROUND(0x10000UL * MARK_FREQ, CONFIG_AFSK_DAC_SAMPLERATE))
 
 #define SPACE_FREQ 2200
-#define SPACE_INC  (uint16_t)(DIV_ROUND(SIN_LEN * (uint32_t)SPACE_FREQ, CONFIG_AFSK_DAC_SAMPLERATE))
+#define SPACE_INC  (uint16_t)(DIV_ROUND(0x10000UL * SPACE_FREQ, CONFIG_AFSK_DAC_SAMPLERATE))
+
+/*
+ * The DAC sample rate needs not be a multiple of the bit rate: the bit
+ * clock counts in 1/BITRATE of a sample and carries the fraction over,
+ * the bits last DAC_SAMPLERATE / BITRATE samples on average.
+ */
+STATIC_ASSERT(CONFIG_AFSK_DAC_SAMPLERATE > 2 * SPACE_FREQ);
+STATIC_ASSERT(CONFIG_AFSK_DAC_SAMPLERATE + BITRATE <= UINT16_MAX);
+
+STATIC_ASSERT(CONFIG_AFSK_DAC_BITS >= 1 && CONFIG_AFSK_DAC_BITS <= 8);
+
+/* Full wave table: 64 entries are enough for 4 bit samples, 256 past them */
+#define DAC_TABLE_BITS  ((CONFIG_AFSK_DAC_BITS <= 4) ? 6 : 8)
+#define DAC_TABLE_LEN   (1 << DAC_TABLE_BITS)
+
+/*
+ * The wave table is computed by the compiler. The sine is folded into the
+ * first quarter of wave and taken from its Taylor series up to x^9: the
+ * error is below 4e-6, 1/1000 of the least significant bit of 8 bit samples.
+ * The samples are rounded to CONFIG_AFSK_DAC_BITS and left aligned,
+ * plus half the least significant bit: 128 is the middle of the DAC,
+ * whose lower bits are dropped.
+ */
+#define DAC_LEVELS      (1 << CONFIG_AFSK_DAC_BITS)
+#define DAC_QUAD(i)     ((i) % (DAC_TABLE_LEN / 2))
+#define DAC_FOLD(i)     ((DAC_QUAD(i) < DAC_TABLE_LEN / 4) ? DAC_QUAD(i) : DAC_TABLE_LEN / 2 - DAC_QUAD(i))
+#define DAC_X(i)        (DAC_FOLD(i) * (2 * 3.14159265358979 / DAC_TABLE_LEN))
+#define DAC_X2(i)       (DAC_X(i) * DAC_X(i))
+#define DAC_SIN_Q(i)    (DAC_X(i) * (1 - DAC_X2(i) / 6 * (1 - DAC_X2(i) / 20 * (1 - DAC_X2(i) / 42 * (1 - DAC_X2(i) / 72)))))
+#define DAC_SIN(i)      (((i) < DAC_TABLE_LEN / 2) ? DAC_SIN_Q(i) : -DAC_SIN_Q(i))
+#define DAC_LEVEL(i)    (unsigned)((DAC_LEVELS - 1) / 2.0 * (1 + DAC_SIN(i)) + 0.5)
+#define DAC_SAMPLE(i)   (uint8_t)(DAC_LEVEL(i) * (256U / DAC_LEVELS) + 128U / DAC_LEVELS)
+
+#define DAC_T4(i)       DAC_SAMPLE(i), DAC_SAMPLE((i) + 1), DAC_SAMPLE((i) + 2), DAC_SAMPLE((i) + 3)
+#define DAC_T16(i)      DAC_T4(i), DAC_T4((i) + 4), DAC_T4((i) + 8), DAC_T4((i) + 12)
+#define DAC_T64(i)      DAC_T16(i), DAC_T16((i) + 16), DAC_T16((i) + 32), DAC_T16((i) + 48)
 
-//Ensure sample rate is a multiple of bit rate
-STATIC_ASSERT(!(CONFIG_AFSK_DAC_SAMPLERATE % BITRATE));
+/**
+ * Full wave table of the modulator, the DAC samples.
+ */
+static const uint8_t PROGMEM dac_table[] =
+{
+#if DAC_TABLE_LEN == 64
+	DAC_T64(0)
+#else
+	DAC_T64(0), DAC_T64(64), DAC_T64(128), DAC_T64(192)
+#endif
+};
+
+STATIC_ASSERT(sizeof(dac_table) == DAC_TABLE_LEN);
 
-#define DAC_SAMPLEPERBIT (CONFIG_AFSK_DAC_SAMPLERATE / BITRATE)
+/*
+ * The ensemble runs one FIR demodulator from its third member on,
+ * the delay line is needed by every other filter.
+ */
+#define AFSK_USE_FIR (CONFIG_AFSK_FILTER == AFSK_FIR || CONFIG_AFSK_ENSEMBLE >= 3)
+#define AFSK_USE_IIR (CONFIG_AFSK_FILTER != AFSK_FIR || CONFIG_AFSK_ENSEMBLE)
 
+#if AFSK_USE_FIR
 /**
- * Sine table for the first quarter of wave.
- * The rest of the wave is computed from this first quarter.
- * This table is used to generate the modulated data.
+ * Sine table for the first quarter of wave, the FIR filters are
+ * designed from it.
  */
 static const uint8_t PROGMEM sin_table[] =
 {
@@ -93,8 +214,98 @@ static const uint8_t PROGMEM sin_table[] =
 #define SIN_LEN 512 ///< Full wave length
 
 STATIC_ASSERT(sizeof(sin_table) == SIN_LEN / 4);
+#endif
+
+/* Frames are checked by the modem, not by the receiving layer */
+#define AFSK_RX_DEFRAME (CONFIG_AFSK_ENSEMBLE || CONFIG_AFSK_RX_FRAMES)
+
+/* The deframer computes the CRC bit by bit, see crc_ccitt_bit() */
+#define AFSK_RX_CRC_BITS (CONFIG_CRC_CCITT_METHOD == CRC_CCITT_BIT)
+
+/*
+ * The ensemble delivers whole frames only: a frame streamed escaped
+ * through a fifo of a few tens of bytes would be lost every time.
+ */
+#if CONFIG_AFSK_ENSEMBLE && !CONFIG_AFSK_RX_FRAMES
+	#error "CONFIG_AFSK_ENSEMBLE needs CONFIG_AFSK_RX_FRAMES"
+#endif
+
+#if CONFIG_AFSK_RX_REPAIR && (!CONFIG_AFSK_RX_FRAMES || CONFIG_AFSK_ENSEMBLE)
+	#error "CONFIG_AFSK_RX_REPAIR needs CONFIG_AFSK_RX_FRAMES and no ensemble"
+#endif
+
+#if AFSK_USE_IIR
+/*
+ * Discriminator lowpass filters: first order IIR filters designed with
+ * the bilinear transform, so that they can be derived from the sample rate:
+ *   y[n] = x[n] + x[n-1] + pole * y[n-1]
+ *   pole = (1 - K) / (1 + K), K = tan(pi * fc / SAMPLERATE)
+ * tan() is replaced by its Pade approximant, good to 1e-4 up to pi/4,
+ * so that the poles are compile time constants.
+ */
+#define IIR_TAN(x)   ((x) * (15 - (x) * (x)) / (15 - 6 * (x) * (x)))
+#define IIR_K(fc)    IIR_TAN(3.14159265 * (fc) / SAMPLERATE)
+
+/** Pole of the filter with cut off frequency \a fc, in 1/256 units */
+#define IIR_POLE(fc) ((int16_t)(256 * (1 - IIR_K(fc)) / (1 + IIR_K(fc)) + 0.5))
+
+/*
+ * Input shift, the output of the filter is up to 2 * x / (1 - pole)
+ * and must fit in 16 bits.
+ */
+#define IIR_SHIFT(pole) (2 + ((pole) > 184) + ((pole) > 220) + ((pole) > 238))
+
+/* Butterworth, as tuned in this modem: pole 21/32 at 9600Hz */
+#define BUTTERWORTH_POLE  IIR_POLE(625)
+/* Chebyshev, as tuned in this modem: pole 1/8 at 9600Hz */
+#define CHEBYSHEV_POLE    IIR_POLE(2020)
+
+#define BUTTERWORTH_SHIFT IIR_SHIFT(BUTTERWORTH_POLE)
+#define CHEBYSHEV_SHIFT   IIR_SHIFT(CHEBYSHEV_POLE)
+
+/**
+ * Feedback of the IIR filters, (y * pole) >> 8 without a 32 bit multiply.
+ * With y = 256 * yh + yl, yl unsigned, it is yh * pole plus the high byte
+ * of yl * pole: exact, the fraction comes only from yl * pole.
+ * This is what the AVR assembly computes; the plain C version is the
+ * reference it is checked against, see afskdec/afskcheck.c.
+ */
+INLINE int16_t iir_pole_mul_split(int16_t y, uint8_t pole)
+{
+	return (int8_t)(y >> 8) * pole + (((uint8_t)y * pole) >> 8);
+}
+
+INLINE int16_t iir_pole_mul_ref(int16_t y, uint8_t pole)
+{
+	return (int16_t)(((int32_t)y * pole) >> 8);
+}
+
+INLINE int16_t iir_pole_mul(int16_t y, uint8_t pole)
+{
+#if CONFIG_AFSK_RX_ASM && CPU_AVR
+	int16_t r;
+
+	/* mulsu takes r16..r23 only, "a" */
+	asm (
+		"mulsu %B1, %2\n\t"      /* r1:r0 = yh * pole, signed */
+		"movw %A0, r0\n\t"
+		"mul %A1, %2\n\t"        /* r1:r0 = yl * pole */
+		"add %A0, r1\n\t"
+		"clr __zero_reg__\n\t"
+		"adc %B0, __zero_reg__"
+		: "=&r" (r)
+		: "a" (y), "a" (pole)
+	);
+	return r;
+#elif CONFIG_AFSK_RX_ASM
+	return iir_pole_mul_split(y, pole);
+#else
+	return iir_pole_mul_ref(y, pole);
+#endif
+}
+#endif
 
-#if (CONFIG_AFSK_FILTER == AFSK_FIR)
+#if AFSK_USE_FIR
 enum fir_filters
 {
 	FIR_1200_BP=0,
@@ -102,38 +313,28 @@ enum fir_filters
 	FIR_1200_LP=2
 };
 
-static FIR fir_table[] =
-{
-	[FIR_1200_BP] = {
-		.taps = 11,
-		.coef = {
-			-12, -16, -15, 0, 20, 29, 20, 0, -15, -16, -12
-		},
-		.mem = {
-			0,
-		},
-	},
-	[FIR_2200_BP] = {
-		.taps = 11,
-		.coef = {
-			11, 15, -8, -26, 4, 30, 4, -26, -8, 15, 11
-		},
-		.mem = {
-			0,
-		},
-	},
-	[FIR_1200_LP] = {
-		.taps = 8,
-		.coef = {
-			-9, 3, 26, 47, 47, 26, 3, -9
-		},
-		.mem = {
-			0,
-		},
-	},
-};
+/* Cut off frequency of the lowpass */
+#define FIR_LP_FREQ 1500
+/* Pedestal of the bandpass window, in 1/127 units: 0 is a plain Hann */
+#define FIR_BP_PEDESTAL 70
+
+/*
+ * Taps of the filters: 11 and 8 at 9600Hz.
+ * The coefficients are computed by fir_design().
+ */
+#define FIR_BP_TAPS ((SAMPLEPERBIT * 11 / 8) | 1)
+#define FIR_LP_TAPS (SAMPLEPERBIT & ~1)
+#define FIR_TAPS(f) ((f) == FIR_1200_LP ? FIR_LP_TAPS : FIR_BP_TAPS)
+
+STATIC_ASSERT(FIR_BP_TAPS <= FIR_MAX_TAPS);
+STATIC_ASSERT(FIR_LP_TAPS <= FIR_MAX_TAPS);
+/* fir_filter() is unrolled for up to 12 pairs of taps */
+STATIC_ASSERT(FIR_BP_TAPS / 2 <= 12);
+
+static FIR fir_table[3];
 #endif
 
+#if AFSK_USE_FIR
 /**
  * Given the index, this function computes the correct sine sample
  * based only on the first quarter of wave.
@@ -149,32 +350,289 @@ INLINE uint8_t sin_sample(uint16_t idx)
 	return (idx >= (SIN_LEN / 2)) ? (255 - data) : data;
 }
 
-#if (CONFIG_AFSK_FILTER == AFSK_FIR)
-static int8_t fir_filter(int8_t s, enum fir_filters f)
+/** Sine of 2 * pi * idx / SIN_LEN, in -127..127 */
+INLINE int16_t fir_sin(uint32_t idx)
+{
+	return (int16_t)sin_sample(idx % SIN_LEN) - 128;
+}
+
+static int8_t fir_round(int32_t x, int32_t div)
+{
+	return (x >= 0 ? x + div / 2 : x - div / 2) / div;
+}
+
+/**
+ * Compute the \a taps coefficients of a FIR filter for the current
+ * sample rate, with a gain of 1 (128) at \a freq or at DC:
+ * - a bandpass centered on \a freq, with a raised Hann window;
+ * - a lowpass cutting off at \a freq, not windowed (the short lowpass
+ *   decodes better with the steeper skirts).
+ * A lowpass must have an even number of taps.
+ */
+static void fir_design(int8_t *coef, uint8_t taps, uint16_t freq, bool bandpass)
 {
-	int8_t Q = fir_table[f].taps - 1;
-	int8_t *B = fir_table[f].coef;
-	int16_t *Bmem = fir_table[f].mem;
+	int16_t raw[FIR_MAX_TAPS];
+	int32_t gain = 0;
 
-	int8_t i;
-	int16_t y;
+	ASSERT(bandpass || !(taps & 1));
 
-	Bmem[0] = s;
-	y = 0;
+	for (uint8_t n = 0; n < taps; n++)
+	{
+		/* Distance from the center, in half samples */
+		uint16_t t = ABS(2 * n - (taps - 1));
+		uint32_t angle = DIV_ROUND((uint32_t)freq * t * SIN_LEN, 2UL * SAMPLERATE);
+
+		if (bandpass)
+		{
+			/*
+			 * The window is computed on the first half and mirrored: the
+			 * rounding of the sine table would make it slightly asymmetric.
+			 */
+			uint8_t m = MIN(n, (uint8_t)(taps - 1 - n));
+			int16_t window = (127 - fir_sin(DIV_ROUND((uint32_t)(m + 1) * SIN_LEN, taps + 1) + SIN_LEN / 4)) / 2;
+			int16_t c = fir_sin(angle + SIN_LEN / 4);
+
+			window = FIR_BP_PEDESTAL + (127 - FIR_BP_PEDESTAL) * window / 127;
+			raw[n] = window * c;
+			gain += (int32_t)raw[n] * c / 127;
+		}
+		else
+		{
+			raw[n] = 127 * fir_sin(angle) / (int16_t)t;
+			gain += raw[n];
+		}
+	}
+
+	for (uint8_t n = 0; n < taps; n++)
+		coef[n] = fir_round((int32_t)raw[n] * 128, gain);
+}
+
+/**
+ * Set up the FIR filter \a f, see fir_design().
+ */
+static void fir_init(enum fir_filters f, uint16_t freq, bool bandpass)
+{
+	FIR *fir = &fir_table[f];
+	uint8_t taps = FIR_TAPS(f);
+	int8_t coef[FIR_MAX_TAPS];
+
+	fir_design(coef, taps, freq, bandpass);
+	memset(fir, 0, sizeof(*fir));
 
-	for (i = Q; i >= 0; i--)
+	/* The coefficients are symmetric, fir_filter() folds them */
+	for (uint8_t n = 0; n < (taps + 1) / 2; n++)
 	{
-		y += Bmem[i] * B[i];
-		Bmem[i + 1] = Bmem[i];
+		ASSERT(coef[n] == coef[taps - 1 - n]);
+		fir->coef[n] = coef[n];
 	}
+}
+
+/*
+ * Multiply and accumulate the k-th pair of samples with the same
+ * coefficient, compiled out past the middle of the filter.
+ */
+#define FIR_MAC(k) \
+	if ((k) < taps / 2) \
+		y += fir->coef[k] * (p[k] + p[taps - 1 - (k)])
+
+/**
+ * Run the FIR filter \a f on the sample \a s.
+ *
+ * The delay line is circular and every sample is written twice, at idx
+ * and at idx + taps, so that the last taps samples are always in a row
+ * from mem[idx], the newest first: nothing is shifted. The coefficients
+ * are symmetric, the samples sharing one are added before the multiply.
+ * Being inlined with a constant \a f, the loop is unrolled for the taps
+ * of the filter.
+ *
+ * The sum is the same, modulo 2^16, as the one of the straight
+ * implementation: the output is bit exact (checked by
+ * afskdec/afskcheck.c).
+ */
+INLINE int8_t fir_filter(int8_t s, enum fir_filters f)
+{
+	const uint8_t taps = FIR_TAPS(f);
+	FIR *fir = &fir_table[f];
+	int16_t y = 0;
+
+	fir->idx = (fir->idx ? fir->idx : taps) - 1;
+	fir->mem[fir->idx] = fir->mem[fir->idx + taps] = s;
+
+	const int8_t *p = &fir->mem[fir->idx];
+
+	FIR_MAC(0); FIR_MAC(1); FIR_MAC(2); FIR_MAC(3);
+	FIR_MAC(4); FIR_MAC(5); FIR_MAC(6); FIR_MAC(7);
+	FIR_MAC(8); FIR_MAC(9); FIR_MAC(10); FIR_MAC(11);
+
+	/* Middle tap of an odd filter */
+	if (taps & 1)
+		y += fir->coef[taps / 2] * p[taps / 2];
 
 	return (int8_t) (y / 128);
 }
 #endif
 
+#if CONFIG_AFSK_ENSEMBLE
+/**
+ * Filter/slicer combinations run by the ensemble.
+ * The first CONFIG_AFSK_ENSEMBLE entries are used; since the FIR
+ * filter memory is static, the table must not hold more than one AFSK_FIR.
+ */
+static const struct
+{
+	uint8_t filter;
+	int8_t slice;
+} ensemble_table[] =
+{
+	{ AFSK_CHEBYSHEV,   0 },
+	{ AFSK_BUTTERWORTH, 0 },
+	{ AFSK_FIR,         0 },
+	{ AFSK_CHEBYSHEV,  -8 },
+};
+
+STATIC_ASSERT(CONFIG_AFSK_ENSEMBLE <= countof(ensemble_table));
+
+/*
+ * Copies of the same frame decoded by different demodulators end
+ * within a few bits from each other, 4 characters is plenty.
+ */
+#define DEDUP_WINDOW (SAMPLEPERBIT * 8 * 4)
+#endif
+
 #define BIT_DIFFER(bitline1, bitline2) (((bitline1) ^ (bitline2)) & 0x01)
 #define EDGE_FOUND(bitline)            BIT_DIFFER((bitline), (bitline) >> 1)
 
+#if CONFIG_AFSK_RX_LEVEL
+/**
+ * Level meter: account an ADC sample.
+ * Cheap enough for the ISR, the window results are computed once per
+ * window and the square roots only by afsk_rxLevel().
+ */
+INLINE void afsk_levelSample(Afsk *af, int8_t s)
+{
+	uint8_t mag = (s < 0) ? -s : s;
+
+	af->lvl_sum += s;
+	af->lvl_sq += (uint16_t)(s * s);
+	if (mag > af->lvl_peak)
+		af->lvl_peak = mag;
+	if ((s == INT8_MIN || s == INT8_MAX) && af->lvl_clipped < UINT16_MAX)
+		af->lvl_clipped++;
+
+	if (++af->lvl_cnt == (1 << LEVEL_SHIFT))
+	{
+		int8_t dc = (af->lvl_sum + (1 << (LEVEL_SHIFT - 1))) >> LEVEL_SHIFT;
+		int32_t var = (int32_t)(af->lvl_sq >> LEVEL_SHIFT) - dc * dc;
+
+		af->lvl_dc = dc;
+		af->lvl_var = MAX(var, (int32_t)0);
+		af->lvl_max = af->lvl_peak;
+		af->lvl_windows++;
+
+		af->lvl_sum = 0;
+		af->lvl_sq = 0;
+		af->lvl_peak = 0;
+		af->lvl_cnt = 0;
+	}
+}
+
+/**
+ * Level meter: account a sample of the frame being received.
+ * The sample is matched with the slicer output of the same instant, past
+ * the delay of the discriminator, and only inside a bit of a steady tone:
+ * the samples around the tone changes would make the levels closer.
+ *
+ * \param af Afsk context.
+ * \param filter discriminator filter of the first demodulator.
+ * \param bits last samples of the slicer output, AfskDemod.sampled_bits.
+ * \param s current sample from the ADC.
+ */
+INLINE void afsk_levelTone(Afsk *af, uint8_t filter, uint8_t bits, int8_t s)
+{
+	uint8_t idx = af->tone_idx++;
+
+	af->tone_hist[idx % AFSK_LEVEL_HIST] = ABS(s - af->lvl_dc);
+	if (bits != 0 && bits != 0xff)
+		return;
+
+	uint8_t tone = bits & 1;
+	uint8_t delay = (filter == AFSK_FIR) ? LEVEL_DELAY_FIR : LEVEL_DELAY_IIR;
+	uint8_t mag = af->tone_hist[(uint8_t)(idx - delay) % AFSK_LEVEL_HIST];
+
+	if (af->tone_cnt[tone] < UINT16_MAX)
+	{
+		af->tone_sq[tone] += (uint16_t)mag * mag;
+		af->tone_cnt[tone]++;
+	}
+}
+
+/**
+ * Level meter: a flag has been received by \a dm, keep the tone levels
+ * if it closed a good frame and start over.
+ */
+INLINE void afsk_levelFrame(Afsk *af, AfskDemod *dm, bool good)
+{
+	/* The meter follows the first demodulator */
+	if (dm != &af->demod[0])
+		return;
+
+	if (good)
+	{
+		memcpy(af->frame_sq, af->tone_sq, sizeof(af->frame_sq));
+		memcpy(af->frame_cnt, af->tone_cnt, sizeof(af->frame_cnt));
+	}
+	memset(af->tone_sq, 0, sizeof(af->tone_sq));
+	memset(af->tone_cnt, 0, sizeof(af->tone_cnt));
+}
+
+/* Integer square root, rounded down */
+static uint8_t level_sqrt(uint16_t x)
+{
+	uint8_t root = 0;
+
+	for (uint8_t bit = 0x80; bit; bit >>= 1)
+		if ((uint16_t)(root | bit) * (root | bit) <= x)
+			root |= bit;
+	return root;
+}
+
+/**
+ * Get the receive audio levels.
+ */
+void afsk_rxLevel(Afsk *af, AfskLevelStats *lvl)
+{
+	uint16_t var;
+	uint32_t sq[2];
+	uint16_t cnt[2];
+
+	ATOMIC(
+		lvl->dc = af->lvl_dc;
+		lvl->peak = af->lvl_max;
+		lvl->clipped = af->lvl_clipped;
+		var = af->lvl_var;
+		memcpy(sq, af->frame_sq, sizeof(sq));
+		memcpy(cnt, af->frame_cnt, sizeof(cnt));
+	);
+
+	lvl->rms = level_sqrt(var);
+	lvl->mark = cnt[0] ? level_sqrt(sq[0] / cnt[0]) : 0;
+	lvl->space = cnt[1] ? level_sqrt(sq[1] / cnt[1]) : 0;
+}
+
+/**
+ * Reset the clipped samples count and the levels of the last frame.
+ */
+void afsk_rxLevelReset(Afsk *af)
+{
+	ATOMIC(
+		af->lvl_clipped = 0;
+		memset(af->frame_sq, 0, sizeof(af->frame_sq));
+		memset(af->frame_cnt, 0, sizeof(af->frame_cnt));
+	);
+}
+#endif
+
+#if !AFSK_RX_DEFRAME
 /**
  * High-Level Data Link Control parsing function.
  * Parse bitstream in order to find characters.
@@ -208,64 +666,904 @@ static bool hdlc_parse(Hdlc *hdlc, bool bit, FIFOBuffer *fifo)
 			AFSK_LED_RX_OFF();
 		}
 
-		hdlc->currchar = 0;
-		hdlc->bit_idx = 0;
-		return ret;
+		hdlc->currchar = 0;
+		hdlc->bit_idx = 0;
+		return ret;
+	}
+
+	/* Reset */
+	if ((hdlc->demod_bits & HDLC_RESET) == HDLC_RESET)
+	{
+		hdlc->rxstart = false;
+		AFSK_LED_RX_OFF();
+		return ret;
+	}
+
+	if (!hdlc->rxstart)
+		return ret;
+
+	/* Stuffed bit */
+	if ((hdlc->demod_bits & 0x3f) == 0x3e)
+		return ret;
+
+	if (hdlc->demod_bits & 0x01)
+		hdlc->currchar |= 0x80;
+
+	if (++hdlc->bit_idx >= 8)
+	{
+		if ((hdlc->currchar == HDLC_FLAG
+			|| hdlc->currchar == HDLC_RESET
+			|| hdlc->currchar == AX25_ESC))
+		{
+			if (!fifo_isfull(fifo))
+				fifo_push(fifo, AX25_ESC);
+			else
+			{
+				hdlc->rxstart = false;
+				AFSK_LED_RX_OFF();
+				ret = false;
+			}
+		}
+
+		if (!fifo_isfull(fifo))
+			fifo_push(fifo, hdlc->currchar);
+		else
+		{
+			hdlc->rxstart = false;
+			AFSK_LED_RX_OFF();
+			ret = false;
+		}
+
+		hdlc->currchar = 0;
+		hdlc->bit_idx = 0;
+	}
+	else
+		hdlc->currchar >>= 1;
+
+	return ret;
+}
+
+#else /* AFSK_RX_DEFRAME */
+
+#if CONFIG_AFSK_RX_FRAMES
+/*
+ * The frames are queued back to back in rx_buf, never wrapped around its
+ * end, so that they can be handed over in place (afsk_rxFrame()):
+ * the queued ones from rx_frames[rx_head].start to rx_start, each
+ * followed by CONFIG_AFSK_RX_ROOM free bytes, then the frame being
+ * received, up to rx_wr. When the queue is empty the next frame starts
+ * over from the beginning of rx_buf.
+ */
+
+/**
+ * \return true if the frame being received fits in rx_buf with \a len bytes.
+ * If it does not and the queue is empty, the frame is moved to the
+ * beginning of rx_buf: this happens only to a frame starting right after
+ * another one, while the latter is still held by the reader.
+ */
+INLINE bool rx_bufFits(Afsk *af, uint16_t len)
+{
+	if ((size_t)af->rx_start + len + CONFIG_AFSK_RX_ROOM <= sizeof(af->rx_buf))
+		return true;
+
+	if (af->rx_cnt || !af->rx_start)
+		return false;
+
+	memmove(af->rx_buf, af->rx_buf + af->rx_start, af->rx_wr - af->rx_start);
+	af->rx_wr -= af->rx_start;
+	af->rx_start = 0;
+	return (size_t)len + CONFIG_AFSK_RX_ROOM <= sizeof(af->rx_buf);
+}
+
+INLINE void rx_bufPut(Afsk *af, uint8_t c)
+{
+	af->rx_buf[af->rx_wr++] = c;
+}
+
+/**
+ * Drop the bytes of the frame being received.
+ */
+INLINE void rx_bufRewind(Afsk *af)
+{
+	if (af->rx_cnt)
+		af->rx_wr = af->rx_start;
+	else
+		af->rx_wr = af->rx_start = 0;
+}
+
+/**
+ * Queue the frame being received, \a len bytes long.
+ * \return the frame descriptor, NULL if the frame queue is full and
+ *         the frame is dropped.
+ */
+static AfskRxFrame *rx_bufCommit(Afsk *af, uint16_t len)
+{
+	if (af->rx_cnt >= CONFIG_AFSK_RX_FRAMES)
+	{
+		rx_bufRewind(af);
+		return NULL;
+	}
+
+	uint8_t idx = af->rx_head + af->rx_cnt;
+	if (idx >= CONFIG_AFSK_RX_FRAMES)
+		idx -= CONFIG_AFSK_RX_FRAMES;
+
+	af->rx_frames[idx].start = af->rx_start;
+	af->rx_frames[idx].len = len;
+	af->rx_cnt++;
+	af->rx_start = af->rx_wr = af->rx_wr + CONFIG_AFSK_RX_ROOM;
+	return &af->rx_frames[idx];
+}
+#endif /* CONFIG_AFSK_RX_FRAMES */
+
+#if CONFIG_AFSK_RX_REPAIR
+/*
+ * Frame repair.
+ * A wrong tone flips two NRZI decoded bits, the one it ends and the next
+ * one: a tone is kept as the index of the first of them in the frame, and
+ * only if both are data bits, flipping a stuffed bit would shift the rest
+ * of the frame.
+ */
+
+/**
+ * Keep the tone ending bit \a pos of the frame if it is among the
+ * CONFIG_AFSK_RX_REPAIR_BITS least confident ones.
+ */
+static void rx_repairAdd(AfskDemod *dm, uint16_t pos, uint8_t conf)
+{
+	uint8_t i = dm->rep_cnt;
+
+	if (i >= CONFIG_AFSK_RX_REPAIR_BITS)
+	{
+		/* Replace the most confident one */
+		uint8_t max = 0;
+		for (i = 1; i < CONFIG_AFSK_RX_REPAIR_BITS; i++)
+			if (dm->rep_conf[i] > dm->rep_conf[max])
+				max = i;
+
+		if (conf >= dm->rep_conf[max])
+			return;
+		i = max;
+	}
+	else
+		dm->rep_cnt++;
+
+	dm->rep_pos[i] = pos;
+	dm->rep_conf[i] = conf;
+}
+
+/**
+ * Track the confidence of the tone of a received data bit.
+ * \param conf confidence of the tone, 1 to 255.
+ */
+INLINE void rx_repairBit(AfskDemod *dm, uint8_t conf)
+{
+	uint16_t pos = dm->frm_len * 8 + dm->hdlc.bit_idx;
+
+	/* This bit is a data bit, the previous tone can be flipped */
+	if (dm->rep_last)
+		rx_repairAdd(dm, pos - 1, dm->rep_last);
+	dm->rep_last = conf;
+}
+
+/**
+ * Save the tones of the frame with a bad CRC just queued in \a frm.
+ */
+static void rx_repairSave(AfskDemod *dm, AfskRxFrame *frm)
+{
+	frm->crc = dm->crc;
+	frm->rep_cnt = 0;
+
+	/* Both the bits of a tone must be in the frame, not in the closing flag */
+	for (uint8_t i = 0; i < dm->rep_cnt; i++)
+		if (dm->rep_pos[i] + 1 < frm->len * 8)
+			frm->rep_pos[frm->rep_cnt++] = dm->rep_pos[i];
+}
+
+/**
+ * \return byte \a i of the queued frame \a frm.
+ */
+INLINE uint8_t *rx_frameByte(Afsk *af, const AfskRxFrame *frm, uint16_t i)
+{
+	return &af->rx_buf[frm->start + i];
+}
+
+/**
+ * CRC change caused by flipping the tone at bit \a pos of a \a len bytes
+ * frame. The CRC is linear: this is the CRC, from 0, of the error pattern.
+ */
+static uint16_t rx_repairSyndrome(uint16_t pos, uint16_t len)
+{
+	uint16_t err = 3 << (pos % 8);
+	uint16_t crc = 0;
+
+	for (uint16_t i = pos / 8; i < len; i++)
+	{
+		crc = updcrc_ccitt(err & 0xff, crc);
+		err >>= 8;
+	}
+	return crc;
+}
+
+static void rx_repairFlip(Afsk *af, const AfskRxFrame *frm, uint16_t pos)
+{
+	*rx_frameByte(af, frm, pos / 8) ^= BV(pos % 8);
+	pos++;
+	*rx_frameByte(af, frm, pos / 8) ^= BV(pos % 8);
+}
+
+/**
+ * Try to repair a queued frame with a bad CRC, flipping up to
+ * CONFIG_AFSK_RX_REPAIR of its least confident tones.
+ * The cost is bounded by a CRC pass over the frame for every tone kept.
+ * A repaired frame is marked good, so it is not repaired again while
+ * it stays at the head of the queue.
+ * \return true if the frame is good now.
+ */
+static bool rx_repair(Afsk *af, AfskRxFrame *frm)
+{
+	uint16_t syn[CONFIG_AFSK_RX_REPAIR_BITS];
+	uint16_t diff = frm->crc ^ AX25_CRC_CORRECT;
+
+	for (uint8_t i = 0; i < frm->rep_cnt; i++)
+	{
+		syn[i] = rx_repairSyndrome(frm->rep_pos[i], frm->len);
+		if (syn[i] == diff)
+		{
+			rx_repairFlip(af, frm, frm->rep_pos[i]);
+			goto repaired;
+		}
+	}
+
+#if CONFIG_AFSK_RX_REPAIR >= 2
+	for (uint8_t i = 0; i < frm->rep_cnt; i++)
+		for (uint8_t j = i + 1; j < frm->rep_cnt; j++)
+			if ((syn[i] ^ syn[j]) == diff)
+			{
+				rx_repairFlip(af, frm, frm->rep_pos[i]);
+				rx_repairFlip(af, frm, frm->rep_pos[j]);
+				goto repaired;
+			}
+#endif
+	return false;
+
+repaired:
+	frm->crc = AX25_CRC_CORRECT;
+	frm->rep_cnt = 0;
+	af->repaired++;
+	return true;
+}
+#endif /* CONFIG_AFSK_RX_REPAIR */
+
+#if CONFIG_AFSK_ENSEMBLE
+/**
+ * Deliver the good frame received by \a dm, unless another demodulator
+ * of the ensemble has just delivered it.
+ */
+static void afsk_commitFrame(Afsk *af, AfskDemod *dm)
+{
+	uint16_t len = dm->frm_len;
+	uint16_t fcs = dm->frm_buf[len - 2] | (dm->frm_buf[len - 1] << 8);
+
+	for (uint8_t i = 0; i < countof(af->recent); i++)
+	{
+		AfskFrameSig *sig = &af->recent[i];
+
+		if (sig->len == len && sig->fcs == fcs
+			&& (uint16_t)(af->sample_clock - sig->stamp) < DEDUP_WINDOW)
+		{
+			af->dups++;
+			return;
+		}
+	}
+
+	if (!rx_bufFits(af, len))
+	{
+		af->status |= AFSK_RXFIFO_OVERRUN;
+		return;
+	}
+
+	for (uint16_t i = 0; i < len; i++)
+		rx_bufPut(af, dm->frm_buf[i]);
+
+	if (!rx_bufCommit(af, len))
+	{
+		af->status |= AFSK_RXFIFO_OVERRUN;
+		return;
+	}
+
+	AfskFrameSig *sig = &af->recent[af->recent_idx];
+	sig->fcs = fcs;
+	sig->len = len;
+	sig->stamp = af->sample_clock;
+	af->recent_idx = (af->recent_idx + 1) % countof(af->recent);
+
+	dm->frames++;
+}
+#endif /* CONFIG_AFSK_ENSEMBLE */
+
+/**
+ * Store a decoded character of the frame being received by \a dm.
+ * \return false if there is no room left for it.
+ */
+INLINE bool rx_frameStore(Afsk *af, AfskDemod *dm, uint8_t c)
+{
+#if CONFIG_AFSK_ENSEMBLE
+	(void)af;
+	if (dm->frm_len >= sizeof(dm->frm_buf))
+		return false;
+	dm->frm_buf[dm->frm_len] = c;
+#else
+	if (!rx_bufFits(af, dm->frm_len + 1))
+		return false;
+	rx_bufPut(af, c);
+#endif
+	dm->frm_len++;
+#if !AFSK_RX_CRC_BITS
+	dm->crc = updcrc_ccitt(c, dm->crc);
+#endif
+	return true;
+}
+
+#if AFSK_RX_CRC_BITS
+/**
+ * Take off the CRC of \a dm the first 7 bits of the closing flag,
+ * which the deframer takes as data before it sees the flag, last first.
+ * A CRC step is reversible: the polynomial is added iff the top bit is set.
+ */
+INLINE void rx_crcUnflag(AfskDemod *dm)
+{
+	uint16_t crc = dm->crc;
+
+	for (uint8_t i = 0, bits = HDLC_FLAG >> 1; i < 7; i++, bits >>= 1)
+	{
+		bool fb = crc & 0x8000;
+
+		if (fb)
+			crc ^= CRC_CCITT_POLY;
+		crc = (crc << 1) | (fb ^ (bits & 1));
+	}
+	dm->crc = crc;
+}
+#endif
+
+/**
+ * HDLC deframer.
+ * Same as hdlc_parse(), but the characters are stored unescaped and the
+ * CRC is computed on the fly: a frame is delivered only if it is good.
+ *
+ * \param af AFSK context.
+ * \param dm demodulator the bit comes from.
+ * \param bit current bit to be parsed.
+ * \param conf confidence of the tone of the bit, for CONFIG_AFSK_RX_REPAIR.
+ */
+static void hdlc_parse_frame(Afsk *af, AfskDemod *dm, bool bit, uint8_t conf)
+{
+	Hdlc *hdlc = &dm->hdlc;
+
+	hdlc->demod_bits <<= 1;
+	hdlc->demod_bits |= bit ? 1 : 0;
+
+	/* HDLC Flag */
+	if (hdlc->demod_bits == HDLC_FLAG)
+	{
+		bool good = hdlc->rxstart && dm->frm_len >= AX25_MIN_FRAME_LEN;
+
+		#if AFSK_RX_CRC_BITS
+		if (good)
+			rx_crcUnflag(dm);
+		#endif
+
+		if (good && dm->crc != AX25_CRC_CORRECT)
+		{
+		#if CONFIG_AFSK_RX_REPAIR
+			/* Worth a repair only if the clock was locked on a signal */
+			if (!dm->pll_locked)
+		#endif
+			{
+				af->crc_errors++;
+				good = false;
+			}
+		}
+
+		if (good)
+		{
+		#if CONFIG_AFSK_ENSEMBLE
+			afsk_commitFrame(af, dm);
+		#else
+			AfskRxFrame *frm = rx_bufCommit(af, dm->frm_len);
+			if (!frm)
+				af->status |= AFSK_RXFIFO_OVERRUN;
+			#if CONFIG_AFSK_RX_REPAIR
+			else
+				rx_repairSave(dm, frm);
+			#endif
+		#endif
+		}
+		#if !CONFIG_AFSK_ENSEMBLE
+		else
+			rx_bufRewind(af);
+		#endif
+
+		#if CONFIG_AFSK_RX_LEVEL
+		afsk_levelFrame(af, dm, good && dm->crc == AX25_CRC_CORRECT);
+		#endif
+
+		hdlc->rxstart = true;
+		AFSK_LED_RX_ON();
+
+		dm->frm_len = 0;
+		dm->crc = CRC_CCITT_INIT_VAL;
+		#if CONFIG_AFSK_RX_REPAIR
+		dm->rep_cnt = 0;
+		dm->rep_last = 0;
+		#endif
+		hdlc->currchar = 0;
+		hdlc->bit_idx = 0;
+		return;
+	}
+
+	/* Reset */
+	if ((hdlc->demod_bits & HDLC_RESET) == HDLC_RESET)
+	{
+		hdlc->rxstart = false;
+		AFSK_LED_RX_OFF();
+		return;
+	}
+
+	if (!hdlc->rxstart)
+		return;
+
+	/* Stuffed bit */
+	if ((hdlc->demod_bits & 0x3f) == 0x3e)
+	{
+		#if CONFIG_AFSK_RX_REPAIR
+		dm->rep_last = 0;
+		#endif
+		return;
+	}
+
+	#if CONFIG_AFSK_RX_REPAIR
+	rx_repairBit(dm, conf);
+	#else
+	(void)conf;
+	#endif
+
+	if (hdlc->demod_bits & 0x01)
+		hdlc->currchar |= 0x80;
+
+	#if AFSK_RX_CRC_BITS
+	dm->crc = crc_ccitt_bit(dm->crc, hdlc->demod_bits & 0x01);
+	#endif
+
+	if (++hdlc->bit_idx >= 8)
+	{
+		if (!rx_frameStore(af, dm, hdlc->currchar))
+		{
+			/* No room, wait for the next flag */
+			hdlc->rxstart = false;
+			AFSK_LED_RX_OFF();
+			#if !CONFIG_AFSK_ENSEMBLE
+			af->status |= AFSK_RXFIFO_OVERRUN;
+			#endif
+		}
+
+		hdlc->currchar = 0;
+		hdlc->bit_idx = 0;
+	}
+	else
+		hdlc->currchar >>= 1;
+}
+#endif /* AFSK_RX_DEFRAME */
+
+/**
+ * Track the HDLC flags of a demodulator, after its bit is parsed.
+ */
+INLINE void afsk_dcd_flags(AfskDemod *dm)
+{
+	if (dm->hdlc.demod_bits == HDLC_FLAG)
+	{
+		/* Flags are 8 bits apart in the preamble and between frames */
+		if (dm->flag_bits == 8)
+			dm->flag_run = true;
+		dm->flag_bits = 0;
+	}
+	else if (dm->flag_bits < 255)
+	{
+		if (++dm->flag_bits >= DCD_FLAG_BITS)
+			dm->flag_run = false;
+	}
+}
+
+/**
+ * Update the data carrier detect, once a bit of the first demodulator.
+ */
+INLINE void afsk_dcd_update(Afsk *af)
+{
+	for (uint8_t i = 0; i < AFSK_DEMODS; i++)
+	{
+		if (af->demod[i].pll_locked || af->demod[i].flag_run)
+		{
+			af->dcd_hold = DCD_HOLD_BITS;
+			af->dcd = true;
+			return;
+		}
+	}
+
+	if (af->dcd_hold)
+		af->dcd_hold--;
+	else
+		af->dcd = false;
+}
+
+/**
+ * Frequency discriminator of a demodulator.
+ *
+ * \param dm demodulator context.
+ * \param filter filter type, a constant unless the ensemble is enabled.
+ * \param delayed ADC sample delayed by (SAMPLEPERBIT / 2).
+ * \param curr_sample current sample from the ADC.
+ *
+ * \return the filter output, positive for a space tone.
+ */
+INLINE int16_t afsk_discriminate(AfskDemod *dm, uint8_t filter, int8_t delayed, int8_t curr_sample)
+{
+#if AFSK_USE_FIR
+	if (filter == AFSK_FIR)
+	{
+		dm->iir_y[0] = ABS(fir_filter(curr_sample, FIR_1200_BP));
+		dm->iir_y[1] = ABS(fir_filter(curr_sample, FIR_2200_BP));
+	#if CONFIG_AFSK_RX_EQ
+		/* Band levels over the current bit */
+		dm->eq_sum[0] += dm->iir_y[0];
+		dm->eq_sum[1] += dm->iir_y[1];
+
+		int16_t space = dm->iir_y[1];
+		if (dm->pll_locked)
+			space = (space * dm->eq_gain) >> 6;
+		return fir_filter(MINMAX(-128, space - dm->iir_y[0], 127), FIR_1200_LP);
+	#else
+		return fir_filter(dm->iir_y[1] - dm->iir_y[0], FIR_1200_LP);
+	#endif
+	}
+#endif
+
+#if AFSK_USE_IIR
+	/*
+	 * Frequency discrimination is achieved by simply multiplying
+	 * the sample with a delayed sample of (samples per bit) / 2.
+	 * Then the signal is lowpass filtered with a first order
+	 * filter, see IIR_POLE(). The filter implementation is selectable
+	 * through the CONFIG_AFSK_FILTER config variable.
+	 */
+	dm->iir_x[0] = dm->iir_x[1];
+	dm->iir_y[0] = dm->iir_y[1];
+
+	if (filter == AFSK_BUTTERWORTH)
+	{
+		dm->iir_x[1] = (delayed * curr_sample) >> BUTTERWORTH_SHIFT;
+		dm->iir_y[1] = dm->iir_x[0] + dm->iir_x[1]
+			+ iir_pole_mul(dm->iir_y[0], BUTTERWORTH_POLE);
+	}
+	else
+	{
+		dm->iir_x[1] = (delayed * curr_sample) >> CHEBYSHEV_SHIFT;
+		dm->iir_y[1] = dm->iir_x[0] + dm->iir_x[1]
+			+ iir_pole_mul(dm->iir_y[0], CHEBYSHEV_POLE);
+	}
+
+	return dm->iir_y[1];
+#else
+	(void)delayed;
+	(void)curr_sample;
+	return 0;
+#endif
+}
+
+/**
+ * Bit clock PLL: adjust the phase on an edge of the sliced signal
+ * and update the lock state.
+ */
+INLINE void afsk_pll_edge(AfskDemod *dm)
+{
+	int16_t err = dm->curr_phase - PHASE_THRES;
+	int16_t corr;
+
+	/* Average of the error, in 1/256 of a bit */
+	dm->pll_err += (uint16_t)ABS(err) * 32 / SAMPLEPERBIT - (dm->pll_err >> 3);
+	dm->pll_bits = 0;
+
+	if (dm->pll_locked)
+	{
+		if (dm->pll_err > PLL_UNLOCK_ERR)
+			dm->pll_locked = false;
+	}
+	else if (dm->pll_err < PLL_LOCK_ERR)
+	{
+		dm->pll_locked = true;
+		#if CONFIG_AFSK_RX_EQ
+		/* A new signal, restart the estimates */
+		dm->eq_bits[0] = dm->eq_bits[1] = 0;
+		#endif
+	}
+
+	if (dm->pll_locked)
+		corr = err / (1 << PLL_TRACK_SHIFT);
+	else
+		corr = err / (1 << PLL_ACQ_SHIFT);
+
+	/* Small errors still get the smallest correction */
+	if (corr == 0 && err)
+		corr = (err > 0) ? PHASE_INC : -PHASE_INC;
+
+	dm->curr_phase -= corr;
+}
+
+#if CONFIG_AFSK_RX_EQ
+/**
+ * Receive equalizer: update the estimates on a bit sampled with the clock
+ * locked. Only the second and following bits of a run of the same tone are
+ * used, the discriminator output has settled on them.
+ *
+ * The slicer is moved towards the midpoint of the mark and space outputs,
+ * following the tone offset of the transmitter and the asymmetry caused by
+ * the twist. The output on the louder tone is also the noisier one, so the
+ * best threshold is only part of the way: half of it, a quarter with the
+ * wide Chebyshev lowpass (measured with afsksim).
+ * The FIR demodulator also scales its 2200Hz band, again by about half of
+ * the level difference in dB. The IIR discriminator output can only be
+ * offset, a gain on one of its polarities would not move the zero crossings.
+ *
+ * \param dm demodulator context.
+ * \param slice slicer threshold.
+ */
+INLINE void afsk_eqUpdate(AfskDemod *dm, int8_t slice)
+{
+	/* The tone has changed, not settled */
+	if (EDGE_FOUND(dm->found_bits))
+		return;
+
+	/*
+	 * Outputs averaged over the last bit: sampled at the bit clock, the
+	 * ripple of the discriminator at twice the mark frequency would be
+	 * always taken at the same phase.
+	 */
+	int16_t out = dm->eq_out / SAMPLEPERBIT;
+	uint8_t tone = out > slice;
+	uint16_t lvl = dm->eq_sum[tone] / SAMPLEPERBIT;
+
+	if (dm->eq_bits[tone] == 0)
+	{
+		dm->eq_avg[tone] = (int32_t)out << EQ_SHIFT;
+		dm->eq_lvl[tone] = lvl << EQ_SHIFT;
+		dm->eq_bits[tone]++;
+		return;
+	}
+
+	/* Skip the bits far weaker than the tone: noise at the end of a signal */
+	if (ABS(out - slice) < ABS((dm->eq_avg[tone] >> EQ_SHIFT) - slice) / 2)
+		return;
+
+	dm->eq_avg[tone] += out - (dm->eq_avg[tone] >> EQ_SHIFT);
+	dm->eq_lvl[tone] += lvl - (dm->eq_lvl[tone] >> EQ_SHIFT);
+
+	if (dm->eq_bits[tone] < EQ_MIN_BITS)
+	{
+		dm->eq_bits[tone]++;
+		return;
+	}
+	if (dm->eq_bits[!tone] < EQ_MIN_BITS || dm->eq_avg[1] <= dm->eq_avg[0])
+		return;
+
+	dm->eq_center = (dm->eq_avg[0] + dm->eq_avg[1])
+		>> (EQ_SHIFT + (dm->filter == AFSK_CHEBYSHEV ? 3 : 2));
+
+	if (dm->filter == AFSK_FIR)
+	{
+		/* 2 * l0 / (l0 + l1) is about the square root of l0 / l1 */
+		uint8_t gain = (uint32_t)dm->eq_lvl[0] * 128 / (dm->eq_lvl[0] + dm->eq_lvl[1]);
+		dm->eq_gain = MAX(gain, (uint8_t)EQ_GAIN_MIN);
+	}
+}
+
+/**
+ * Get the receive equalizer estimates of the first demodulator.
+ */
+void afsk_rxEq(Afsk *af, AfskEqStats *eq)
+{
+	AfskDemod *dm = &af->demod[0];
+
+	ATOMIC(
+		eq->mark = dm->eq_avg[0] >> EQ_SHIFT;
+		eq->space = dm->eq_avg[1] >> EQ_SHIFT;
+		eq->center = dm->eq_center;
+		eq->gain = dm->eq_gain;
+	);
+}
+#endif
+
+#if CONFIG_AFSK_ENSEMBLE
+void afsk_rxEnsemble(Afsk *af, AfskEnsembleStats *st)
+{
+	ATOMIC(
+		st->dups = af->dups;
+		for (uint8_t i = 0; i < CONFIG_AFSK_ENSEMBLE; i++)
+			st->frames[i] = af->demod[i].frames;
+	);
+}
+#endif
+
+/**
+ * Run one demodulator on the current sample: discriminator, slicer,
+ * bit clock recovery and HDLC parsing.
+ */
+INLINE void afsk_demod(Afsk *af, AfskDemod *dm, uint8_t filter, int8_t slice, int8_t delayed, int8_t curr_sample)
+{
+	int16_t out = afsk_discriminate(dm, filter, delayed, curr_sample);
+
+	#if CONFIG_AFSK_RX_EQ
+	/*
+	 * The corrections apply only while the clock is locked: a wrong one
+	 * could otherwise prevent the lock on the next signal.
+	 */
+	dm->eq_out += out;
+	if (dm->pll_locked)
+		out -= dm->eq_center;
+	#endif
+
+	/* Save this sampled bit in a delay line */
+	dm->sampled_bits <<= 1;
+	dm->sampled_bits |= (out > slice) ? 1 : 0;
+
+	#if CONFIG_AFSK_RX_LEVEL
+	if (dm == &af->demod[0] && dm->hdlc.rxstart)
+		afsk_levelTone(af, filter, dm->sampled_bits, curr_sample);
+	#endif
+
+//kprintf("%+03d %+03d %+03d %d\n", curr_sample, dm->iir_x[1], dm->iir_y[1], (af->dcd)?1:0);
+
+	/* If there is an edge, adjust phase sampling */
+	if (EDGE_FOUND(dm->sampled_bits))
+		afsk_pll_edge(dm);
+	dm->curr_phase += PHASE_BIT;
+
+	/* sample the bit */
+	if (dm->curr_phase >= PHASE_MAX)
+	{
+		dm->curr_phase %= PHASE_MAX;
+
+		if (dm->pll_bits < PLL_MAX_BITS)
+			dm->pll_bits++;
+		else
+		{
+			dm->pll_err = AFSK_PLL_ERR_NOISE;
+			dm->pll_locked = false;
+		}
+
+		/* Shift 1 position in the shift register of the found bits */
+		dm->found_bits <<= 1;
+
+		/*
+		 * Determine bit value by reading the last VOTE_BITS sampled bits.
+		 * If most of them are ones, the bit value is a 1,
+		 * otherwise is a 0.
+		 */
+		uint8_t ones = 0;
+		for (uint8_t i = 0; i < VOTE_BITS; i++)
+			ones += (dm->sampled_bits >> i) & 1;
+		if (ones > VOTE_BITS / 2)
+			dm->found_bits |= 1;
+
+		#if CONFIG_AFSK_RX_EQ
+		if (dm->pll_locked)
+			afsk_eqUpdate(dm, slice);
+		dm->eq_out = 0;
+		dm->eq_sum[0] = dm->eq_sum[1] = 0;
+		#endif
+
+		/*
+		 * NRZI coding: if 2 consecutive bits have the same value
+		 * a 1 is received, otherwise it's a 0.
+		 */
+#if AFSK_RX_DEFRAME
+		/* The confidence of the tone is the distance from the slicer */
+		hdlc_parse_frame(af, dm, !EDGE_FOUND(dm->found_bits), MINMAX(1, ABS(out - slice), 255));
+#else
+		if (!hdlc_parse(&dm->hdlc, !EDGE_FOUND(dm->found_bits), &af->rx_fifo))
+			af->status |= AFSK_RXFIFO_OVERRUN;
+	#if CONFIG_AFSK_RX_LEVEL
+		/* The CRC is checked later: any frame long enough counts */
+		if (dm->hdlc.demod_bits == HDLC_FLAG)
+			afsk_levelFrame(af, dm, (uint32_t)af->tone_cnt[0] + af->tone_cnt[1]
+				>= AX25_MIN_FRAME_LEN * 8 * SAMPLEPERBIT);
+	#endif
+#endif
+
+		afsk_dcd_flags(dm);
+		/* Carrier detect follows the bit clock of the first demodulator */
+		if (dm == &af->demod[0])
+			afsk_dcd_update(af);
 	}
+}
 
-	/* Reset */
-	if ((hdlc->demod_bits & HDLC_RESET) == HDLC_RESET)
+/**
+ * Run the demodulators on one sample.
+ * \param af Afsk context to operate on.
+ * \param delayed sample delayed by (SAMPLEPERBIT / 2).
+ * \param curr_sample current sample from the ADC.
+ */
+INLINE void afsk_rxSample(Afsk *af, int8_t delayed, int8_t curr_sample)
+{
+#if CONFIG_AFSK_ENSEMBLE
+	af->sample_clock++;
+	for (uint8_t i = 0; i < CONFIG_AFSK_ENSEMBLE; i++)
 	{
-		hdlc->rxstart = false;
-		AFSK_LED_RX_OFF();
-		return ret;
+		AfskDemod *dm = &af->demod[i];
+		afsk_demod(af, dm, dm->filter, dm->slice, delayed, curr_sample);
 	}
+#else
+	afsk_demod(af, &af->demod[0], CONFIG_AFSK_FILTER, 0, delayed, curr_sample);
+#endif
+}
 
-	if (!hdlc->rxstart)
-		return ret;
-
-	/* Stuffed bit */
-	if ((hdlc->demod_bits & 0x3f) == 0x3e)
-		return ret;
+#if CONFIG_AFSK_RX_BLOCK
+#define RX_RING_MASK (CONFIG_AFSK_RX_BLOCK - 1)
+/* Demodulated samples kept in the ring for the delay line */
+#define RX_RING_HIST (SAMPLEPERBIT / 2)
 
-	if (hdlc->demod_bits & 0x01)
-		hdlc->currchar |= 0x80;
+STATIC_ASSERT(!(CONFIG_AFSK_RX_BLOCK & RX_RING_MASK));
+/* The free running 8 bit indexes tell a full ring from an empty one */
+STATIC_ASSERT(CONFIG_AFSK_RX_BLOCK <= 128);
+STATIC_ASSERT(CONFIG_AFSK_RX_BLOCK > RX_RING_HIST * 2);
 
-	if (++hdlc->bit_idx >= 8)
-	{
-		if ((hdlc->currchar == HDLC_FLAG
-			|| hdlc->currchar == HDLC_RESET
-			|| hdlc->currchar == AX25_ESC))
-		{
-			if (!fifo_isfull(fifo))
-				fifo_push(fifo, AX25_ESC);
-			else
-			{
-				hdlc->rxstart = false;
-				AFSK_LED_RX_OFF();
-				ret = false;
-			}
-		}
+/**
+ * ADC ISR callback.
+ * This function has to be called by the ADC ISR when a sample of the configured
+ * channel is available. The sample is only stored, see afsk_rxProcess().
+ * \param af Afsk context to operate on.
+ * \param curr_sample current sample from the ADC.
+ */
+void afsk_adc_isr(Afsk *af, int8_t curr_sample)
+{
+	uint8_t wr = af->ring_wr;
 
-		if (!fifo_isfull(fifo))
-			fifo_push(fifo, hdlc->currchar);
-		else
-		{
-			hdlc->rxstart = false;
-			AFSK_LED_RX_OFF();
-			ret = false;
-		}
+	#if CONFIG_AFSK_RX_LEVEL
+	afsk_levelSample(af, curr_sample);
+	#endif
 
-		hdlc->currchar = 0;
-		hdlc->bit_idx = 0;
+	if ((uint8_t)(wr - af->ring_rd) >= CONFIG_AFSK_RX_BLOCK - RX_RING_HIST)
+	{
+		af->ring_overruns++;
+		return;
 	}
-	else
-		hdlc->currchar >>= 1;
 
-	return ret;
+	af->rx_ring[wr & RX_RING_MASK] = curr_sample;
+	af->ring_wr = wr + 1;
 }
 
+/**
+ * Demodulate the samples stored by the ADC ISR.
+ * The samples are processed in blocks, the samples arrived in the meantime
+ * are processed before returning.
+ * \param af Afsk context to operate on.
+ */
+void afsk_rxProcess(Afsk *af)
+{
+	const int8_t *ring = af->rx_ring;
+	uint8_t rd = af->ring_rd;
+	uint8_t wr;
+
+	while ((wr = af->ring_wr) != rd)
+	{
+		for (; rd != wr; rd++)
+			afsk_rxSample(af, ring[(uint8_t)(rd - RX_RING_HIST) & RX_RING_MASK],
+				ring[rd & RX_RING_MASK]);
 
+		/* Free the block */
+		af->ring_rd = rd;
+	}
+}
+#else
 /**
  * ADC ISR callback.
  * This function has to be called by the ADC ISR when a sample of the configured
@@ -277,165 +1575,161 @@ void afsk_adc_isr(Afsk *af, int8_t curr_sample)
 {
 	/*
 	 * Frequency discriminator and LP IIR filter.
-	 * This filter is designed to work
-	 * at the given sample rate and bit rate.
-	 */
-	STATIC_ASSERT(SAMPLERATE == 9600);
-	STATIC_ASSERT(BITRATE == 1200);
-
-#if (CONFIG_AFSK_FILTER != AFSK_FIR)
-
-	/*
-	 * Frequency discrimination is achieved by simply multiplying
-	 * the sample with a delayed sample of (samples per bit) / 2.
-	 * Then the signal is lowpass filtered with a first order,
-	 * 600 Hz filter. The filter implementation is selectable
-	 * through the CONFIG_AFSK_FILTER config variable.
+	 * The filters are derived from the sample rate,
+	 * see IIR_POLE() and fir_design().
 	 */
-	af->iir_x[0] = af->iir_x[1];
-
-	#if (CONFIG_AFSK_FILTER == AFSK_BUTTERWORTH)
-		af->iir_x[1] = ((int8_t)fifo_pop(&af->delay_fifo) * curr_sample) >> 2;
-		//af->iir_x[1] = ((int8_t)fifo_pop(&af->delay_fifo) * curr_sample) / 6.027339492;
-	#elif (CONFIG_AFSK_FILTER == AFSK_CHEBYSHEV)
-		af->iir_x[1] = ((int8_t)fifo_pop(&af->delay_fifo) * curr_sample) >> 2;
-		//af->iir_x[1] = ((int8_t)fifo_pop(&af->delay_fifo) * curr_sample) / 3.558147322;
-	#else
-		#error Filter type not found!
-	#endif
+#if AFSK_USE_IIR
+	int8_t delayed = af->delay_buf[af->delay_idx];
+#else
+	int8_t delayed = 0;
+#endif
 
-	af->iir_y[0] = af->iir_y[1];
+#if CONFIG_AFSK_RX_LEVEL
+	afsk_levelSample(af, curr_sample);
+#endif
 
-	#if CONFIG_AFSK_FILTER == AFSK_BUTTERWORTH
-		/*
-		 * This strange sum + shift is an optimization for af->iir_y[0] * 0.668.
-		 * iir * 0.668 ~= (iir * 21) / 32 =
-		 * = (iir * 16) / 32 + (iir * 4) / 32 + iir / 32 =
-		 * = iir / 2 + iir / 8 + iir / 32 =
-		 * = iir >> 1 + iir >> 3 + iir >> 5
-		 */
-		af->iir_y[1] = af->iir_x[0] + af->iir_x[1] + (af->iir_y[0] >> 1) + (af->iir_y[0] >> 3) + (af->iir_y[0] >> 5);
-		//af->iir_y[1] = af->iir_x[0] + af->iir_x[1] + af->iir_y[0] * 0.6681786379;
-	#elif CONFIG_AFSK_FILTER == AFSK_CHEBYSHEV
-		/*
-		 * This should be (af->iir_y[0] * 0.438) but
-		 * (af->iir_y[0] >> 1) is a faster approximation :-)
-		 */
-		af->iir_y[1] = af->iir_x[0] + af->iir_x[1] + (af->iir_y[0] >> 3);
-		//af->iir_y[1] = af->iir_x[0] + af->iir_x[1] + af->iir_y[0] * 0.4379097269;
-	#endif
+	afsk_rxSample(af, delayed, curr_sample);
 
-	/* Save this sampled bit in a delay line */
-	af->sampled_bits <<= 1;
-	af->sampled_bits |= (af->iir_y[1] > 0) ? 1 : 0;
-
-	if (ABS(af->iir_y[1]) - 20 > 0) {
-		af->cd_state++;
-		if (af->cd_state > 30) {
-			af->cd_state = 30;
-			af->cd = true;
-		}
-	} else {
-		if (af->cd_state > 0) {
-			af->cd_state --;
+#if AFSK_USE_IIR
+	/* The current sample replaces the oldest one in the delay line */
+	af->delay_buf[af->delay_idx] = curr_sample;
+	if (++af->delay_idx >= sizeof(af->delay_buf))
+		af->delay_idx = 0;
+#endif
+}
+#endif /* CONFIG_AFSK_RX_BLOCK */
 
-			if (af->cd_state == 0) {
-				af->cd = false;
-			}
-		}
+static void afsk_txStart(Afsk *af)
+{
+	if (!af->sending)
+	{
+		#if !CONFIG_AFSK_TX_PREENCODE
+		/* Pre-encoded tones go on from the tone the last keyup ended with */
+		af->phase_inc = MARK_INC;
+		#endif
+		af->phase_acc = 0;
+		af->stuff_cnt = 0;
+		af->keyup_frames = 0;
+		af->keyup_len = af->preamble_flags;
+		af->sending = true;
+		af->preamble_len = af->preamble_flags;
+		AFSK_DAC_IRQ_START(af->dac_ch);
 	}
+	ATOMIC(af->trailer_len  = af->trailer_flags);
+}
 
-	/* Store current ADC sample in the af->delay_fifo */
-	fifo_push(&af->delay_fifo, curr_sample);
+/* Max length of a keyup, in characters */
+#define BUNDLE_LEN DIV_ROUND(CONFIG_AFSK_TX_BUNDLE_MS * BITRATE, 8000)
 
-#elif (CONFIG_AFSK_FILTER == AFSK_FIR)
+/**
+ * Check if a new frame can join the transmission in progress.
+ * \return true if the transmitter is keyed up and the frame and
+ *         airtime caps of this keyup have not been reached yet.
+ */
+bool afsk_txBundleOk(Afsk *af)
+{
+	bool ok;
 
-#define DCD_LEVEL 5
+	ATOMIC(ok = af->sending
+		&& af->keyup_frames < CONFIG_AFSK_TX_BUNDLE_FRAMES
+		&& af->keyup_len < BUNDLE_LEN);
+	return ok;
+}
 
-	af->iir_y[0] = ABS(fir_filter(curr_sample, FIR_1200_BP));
-	af->iir_y[1] = ABS(fir_filter(curr_sample, FIR_2200_BP));
+/*
+ * Look for frame starts in the character stream written by the upper layer.
+ * A frame that would exceed the caps of the current keyup waits for the
+ * transmitter to go idle, so it gets its own preamble.
+ */
+static void afsk_txFrameCheck(Afsk *af, uint8_t c)
+{
+	if (af->tx_esc)
+		af->tx_esc = false;
+	else if (c == AX25_ESC)
+		af->tx_esc = true;
+	else if (c == HDLC_FLAG || c == HDLC_RESET)
+	{
+		af->tx_inframe = false;
+		return;
+	}
 
-	af->sampled_bits <<= 1;
-	af->sampled_bits |= fir_filter(af->iir_y[1] - af->iir_y[0], FIR_1200_LP) > 0;
+	if (!af->tx_inframe)
+	{
+		af->tx_inframe = true;
 
-	if (af->iir_y[1] > DCD_LEVEL || af->iir_y[0] > DCD_LEVEL) {
-		af->cd_state++;
-		if (af->cd_state > 30) {
-			af->cd_state = 30;
-			af->cd = true;
-		}
-	} else {
-		if (af->cd_state > 0) {
-			af->cd_state --;
+		if (af->sending && !afsk_txBundleOk(af))
+			while (af->sending)
+				cpu_relax();
 
-			if (af->cd_state == 0) {
-				af->cd = false;
-			}
-		}
+		af->keyup_frames++;
 	}
+}
 
-#endif
+#define BIT_STUFF_LEN 5
 
-//kprintf("%+03d %+03d %+03d %d\n", curr_sample, af->iir_x[1], af->iir_y[1], (af->cd)?1:0);
+#if CONFIG_AFSK_TX_PREENCODE
+/*
+ * Tones of an HDLC_FLAG, 1 for mark, first tone in the LSB.
+ * A flag holds two 0 bits, so it ends on the tone it started from:
+ * with NRZI the first 7 tones are the other one.
+ */
+#define FLAG_TONES(inc)  (((inc) == MARK_INC) ? 0x80 : 0x7F)
 
+/**
+ * Queue one bit to be transmitted, NRZI encoded:
+ * a 0 switches the tone, a 1 keeps it.
+ */
+INLINE void afsk_encBit(Afsk *af, bool bit)
+{
+	if (!bit)
+		af->enc_tone = !af->enc_tone;
 
-	/* If there is an edge, adjust phase sampling */
-	if (EDGE_FOUND(af->sampled_bits))
-	{
-		if (af->curr_phase < PHASE_THRES)
-			af->curr_phase += PHASE_INC;
-		else
-			af->curr_phase -= PHASE_INC;
-	}
-	af->curr_phase += PHASE_BIT;
+	af->enc_tones >>= 1;
+	if (af->enc_tone)
+		af->enc_tones |= 0x80;
 
-	/* sample the bit */
-	if (af->curr_phase >= PHASE_MAX)
+	if (++af->enc_cnt >= 8)
 	{
-		af->curr_phase %= PHASE_MAX;
-
-		/* Shift 1 position in the shift register of the found bits */
-		af->found_bits <<= 1;
-
-		/*
-		 * Determine bit value by reading the last 3 sampled bits.
-		 * If the number of ones is two or greater, the bit value is a 1,
-		 * otherwise is a 0.
-		 * This algorithm presumes that there are 8 samples per bit.
-		 */
-		STATIC_ASSERT(SAMPLEPERBIT == 8);
-		uint8_t bits = af->sampled_bits & 0x07;
-		if (bits == 0x07 // 111, 3 bits set to 1
-		 || bits == 0x06 // 110, 2 bits
-		 || bits == 0x05 // 101, 2 bits
-		 || bits == 0x03 // 011, 2 bits
-		)
-			af->found_bits |= 1;
+		while (fifo_isfull_locked(&af->tx_fifo))
+			cpu_relax();
 
-		/*
-		 * NRZI coding: if 2 consecutive bits have the same value
-		 * a 1 is received, otherwise it's a 0.
-		 */
-		if (!hdlc_parse(&af->hdlc, !EDGE_FOUND(af->found_bits), &af->rx_fifo))
-			af->status |= AFSK_RXFIFO_OVERRUN;
+		fifo_push_locked(&af->tx_fifo, af->enc_tones);
+		afsk_txStart(af);
+		af->enc_cnt = 0;
 	}
 }
 
-static void afsk_txStart(Afsk *af)
+/**
+ * Encode a character, LSB first.
+ * \param stuff true to insert a 0 after 5 consecutive 1s (frame contents).
+ */
+static void afsk_encChar(Afsk *af, uint8_t c, bool stuff)
 {
-	if (!af->sending)
+	for (uint8_t i = 0; i < 8; i++, c >>= 1)
 	{
-		af->phase_inc = MARK_INC;
-		af->phase_acc = 0;
-		af->stuff_cnt = 0;
-		af->sending = true;
-		af->preamble_len = DIV_ROUND(CONFIG_AFSK_PREAMBLE_LEN * BITRATE, 8000);
-		AFSK_DAC_IRQ_START(af->dac_ch);
+		afsk_encBit(af, c & 0x01);
+
+		if (!stuff || !(c & 0x01))
+			af->enc_ones = 0;
+		else if (++af->enc_ones >= BIT_STUFF_LEN)
+		{
+			afsk_encBit(af, 0);
+			af->enc_ones = 0;
+		}
 	}
-	ATOMIC(af->trailer_len  = DIV_ROUND(CONFIG_AFSK_TRAILER_LEN  * BITRATE, 8000));
 }
 
-#define BIT_STUFF_LEN 5
+/**
+ * Complete the tones being collected after the end of a frame.
+ * Holding the tone sends 1s, which can only be taken as an abort
+ * sequence once the closing flag has been sent.
+ */
+static void afsk_encFlush(Afsk *af)
+{
+	while (af->enc_cnt)
+		afsk_encBit(af, 1);
+}
+#endif
 
 #define SWITCH_TONE(inc)  (((inc) == MARK_INC) ? SPACE_INC : MARK_INC)
 
@@ -453,8 +1747,44 @@ uint8_t afsk_dac_isr(Afsk *af)
 	uint8_t value = 0;
 	AFSK_LED_TX_ON();
 
+#if CONFIG_AFSK_TX_PREENCODE
+	/* Check if we are at a start of a sample cycle */
+	if (af->sample_count < BITRATE)
+	{
+		if (af->tx_bit == 0)
+		{
+			/* We have just finished transimitting 8 tones, get new ones. */
+			if (af->preamble_len)
+			{
+				af->preamble_len--;
+				af->curr_out = FLAG_TONES(af->phase_inc);
+			}
+			else if (!fifo_isempty(&af->tx_fifo))
+				af->curr_out = fifo_pop(&af->tx_fifo);
+			else if (af->trailer_len)
+			{
+				af->trailer_len--;
+				af->curr_out = FLAG_TONES(af->phase_inc);
+			}
+			else
+			{
+				AFSK_DAC_IRQ_STOP(af->dac_ch);
+				af->sending = false;
+				goto exit; // return;
+			}
+
+			/* Start with LSB mask */
+			af->tx_bit = 0x01;
+		}
+
+		/* Tones are already NRZI encoded and stuffed */
+		af->phase_inc = (af->curr_out & af->tx_bit) ? MARK_INC : SPACE_INC;
+		af->tx_bit <<= 1;
+		af->sample_count += CONFIG_AFSK_DAC_SAMPLERATE;
+	}
+#else
 	/* Check if we are at a start of a sample cycle */
-	if (af->sample_count == 0)
+	if (af->sample_count < BITRATE)
 	{
 		if (af->tx_bit == 0)
 		{
@@ -554,26 +1884,106 @@ uint8_t afsk_dac_isr(Afsk *af)
 			/* Go to the next bit */
 			af->tx_bit <<= 1;
 		}
-		af->sample_count = DAC_SAMPLEPERBIT;
+		af->sample_count += CONFIG_AFSK_DAC_SAMPLERATE;
 	}
+#endif
 
 	/* Get new sample and put it out on the DAC */
 	af->phase_acc += af->phase_inc;
-	af->phase_acc %= SIN_LEN;
 
-	af->sample_count--;
-	value = sin_sample(af->phase_acc);
+	af->sample_count -= BITRATE;
+	value = pgm_read8(&dac_table[af->phase_acc >> (16 - DAC_TABLE_BITS)]);
 exit:
 	AFSK_LED_TX_OFF();
 	return value;
 }
 
 
+#if CONFIG_AFSK_RX_FRAMES
+/**
+ * Remove the head frame from the queue.
+ */
+INLINE void rx_framePop(Afsk *af)
+{
+	ATOMIC(
+		if (++af->rx_head >= CONFIG_AFSK_RX_FRAMES)
+			af->rx_head = 0;
+		af->rx_cnt--;
+	);
+}
+
+uint8_t *afsk_rxFrame(Afsk *af, size_t *len, size_t *size)
+{
+	AfskRxFrame *frm;
+
+	afsk_rxProcess(af);
+	for (;;)
+	{
+		if (af->rx_cnt == 0)
+			return NULL;
+
+		frm = &af->rx_frames[af->rx_head];
+		#if CONFIG_AFSK_RX_REPAIR
+		if (frm->crc != AX25_CRC_CORRECT && !rx_repair(af, frm))
+		{
+			ATOMIC(af->crc_errors++);
+			rx_framePop(af);
+			continue;
+		}
+		#endif
+		break;
+	}
+
+	*len = frm->len;
+	*size = frm->len + CONFIG_AFSK_RX_ROOM;
+	return af->rx_buf + frm->start;
+}
+
+void afsk_rxFrameDone(Afsk *af)
+{
+	ASSERT(af->rx_cnt);
+	rx_framePop(af);
+}
+
+/*
+ * Read the next received frame, at most size bytes of it.
+ * The frame is removed from the queue even if it does not fit.
+ */
+static size_t afsk_read(KFile *fd, void *_buf, size_t size)
+{
+	Afsk *af = AFSK_CAST(fd);
+	uint8_t *frm;
+	size_t len, room;
+
+	#if CONFIG_AFSK_RXTIMEOUT > 0
+	ticks_t start = timer_clock();
+	#endif
+
+	while (!(frm = afsk_rxFrame(af, &len, &room)))
+	{
+		#if CONFIG_AFSK_RXTIMEOUT == 0
+		return 0;
+		#else
+		cpu_relax();
+		#if CONFIG_AFSK_RXTIMEOUT != -1
+		if (timer_clock() - start > ms_to_ticks(CONFIG_AFSK_RXTIMEOUT))
+			return 0;
+		#endif
+		#endif
+	}
+
+	len = MIN(size, len);
+	memcpy(_buf, frm, len);
+	afsk_rxFrameDone(af);
+	return len;
+}
+#else
 static size_t afsk_read(KFile *fd, void *_buf, size_t size)
 {
 	Afsk *af = AFSK_CAST(fd);
 	uint8_t *buf = (uint8_t *)_buf;
 
+	afsk_rxProcess(af);
 	#if CONFIG_AFSK_RXTIMEOUT == 0
 	while (size-- && !fifo_isempty_locked(&af->rx_fifo))
 	#else
@@ -587,6 +1997,7 @@ static size_t afsk_read(KFile *fd, void *_buf, size_t size)
 		while (fifo_isempty_locked(&af->rx_fifo))
 		{
 			cpu_relax();
+			afsk_rxProcess(af);
 			#if CONFIG_AFSK_RXTIMEOUT != -1
 			if (timer_clock() - start > ms_to_ticks(CONFIG_AFSK_RXTIMEOUT))
 				return buf - (uint8_t *)_buf;
@@ -598,6 +2009,7 @@ static size_t afsk_read(KFile *fd, void *_buf, size_t size)
 
 	return buf - (uint8_t *)_buf;
 }
+#endif
 
 static size_t afsk_write(KFile *fd, const void *_buf, size_t size)
 {
@@ -606,11 +2018,34 @@ static size_t afsk_write(KFile *fd, const void *_buf, size_t size)
 
 	while (size--)
 	{
+	#if CONFIG_AFSK_TX_PREENCODE
+		uint8_t c = *buf++;
+		bool escaped = af->tx_esc;
+		bool inframe = af->tx_inframe;
+
+		afsk_txFrameCheck(af, c);
+		af->keyup_len++;
+
+		if (!escaped && c == AX25_ESC)
+			continue;
+
+		if (!escaped && (c == HDLC_FLAG || c == HDLC_RESET))
+		{
+			afsk_encChar(af, c, false);
+			if (inframe)
+				afsk_encFlush(af);
+		}
+		else
+			afsk_encChar(af, c, true);
+	#else
 		while (fifo_isfull_locked(&af->tx_fifo))
 			cpu_relax();
 
+		afsk_txFrameCheck(af, *buf);
 		fifo_push_locked(&af->tx_fifo, *buf++);
 		afsk_txStart(af);
+		af->keyup_len++;
+	#endif
 	}
 
 	return buf - (const uint8_t *)_buf;
@@ -641,6 +2076,23 @@ static void afsk_clearerr(KFile *fd)
 }
 
 
+/**
+ * Set the preamble and trailer lengths used by the next transmissions.
+ * \param af Afsk context to operate on.
+ * \param preamble_ms preamble length in ms (KISS TXDELAY).
+ * \param trailer_ms  trailer length in ms (KISS TXtail).
+ */
+void afsk_setTiming(Afsk *af, uint16_t preamble_ms, uint16_t trailer_ms)
+{
+	uint16_t preamble = DIV_ROUND((uint32_t)preamble_ms * BITRATE, 8000);
+	uint16_t trailer = DIV_ROUND((uint32_t)trailer_ms * BITRATE, 8000);
+
+	ATOMIC(
+		af->preamble_flags = preamble;
+		af->trailer_flags = trailer;
+	);
+}
+
 /**
  * Initialize an AFSK1200 modem.
  * \param af Afsk context to operate on.
@@ -657,13 +2109,38 @@ void afsk_init(Afsk *af, int adc_ch, int dac_ch)
 	af->dac_ch = dac_ch;
 
 	af->phase_inc = MARK_INC;
+	#if CONFIG_AFSK_TX_PREENCODE
+	af->enc_tone = true;
+	#endif
+	afsk_setTiming(af, CONFIG_AFSK_PREAMBLE_LEN, CONFIG_AFSK_TRAILER_LEN);
 
-	fifo_init(&af->delay_fifo, (uint8_t *)af->delay_buf, sizeof(af->delay_buf));
-	fifo_init(&af->rx_fifo, af->rx_buf, sizeof(af->rx_buf));
+#if CONFIG_AFSK_ENSEMBLE
+	for (int i = 0; i < CONFIG_AFSK_ENSEMBLE; i++)
+	{
+		af->demod[i].filter = ensemble_table[i].filter;
+		af->demod[i].slice = ensemble_table[i].slice;
+	}
+#else
+	af->demod[0].filter = CONFIG_AFSK_FILTER;
+#endif
 
-	/* Fill sample FIFO with 0 */
-	for (int i = 0; i < SAMPLEPERBIT / 2; i++)
-		fifo_push(&af->delay_fifo, 0);
+	for (int i = 0; i < AFSK_DEMODS; i++)
+	{
+		af->demod[i].pll_err = AFSK_PLL_ERR_NOISE;
+		#if CONFIG_AFSK_RX_EQ
+		af->demod[i].eq_gain = 64;
+		#endif
+	}
+
+#if AFSK_USE_FIR
+	fir_init(FIR_1200_BP, MARK_FREQ, true);
+	fir_init(FIR_2200_BP, SPACE_FREQ, true);
+	fir_init(FIR_1200_LP, FIR_LP_FREQ, false);
+#endif
+
+#if !CONFIG_AFSK_RX_FRAMES
+	fifo_init(&af->rx_fifo, af->rx_buf, sizeof(af->rx_buf));
+#endif
 
 	fifo_init(&af->tx_fifo, af->tx_buf, sizeof(af->tx_buf));
 
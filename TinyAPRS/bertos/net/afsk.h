@@ -36,7 +36,7 @@
  *
  * $WIZ$ module_name = "afsk"
  * $WIZ$ module_configuration = "bertos/cfg/cfg_afsk.h"
- * $WIZ$ module_depends = "timer", "kfile"
+ * $WIZ$ module_depends = "timer", "kfile", "crc-ccitt"
  * $WIZ$ module_hw = "bertos/hw/hw_afsk.h"
  */
 
@@ -48,6 +48,8 @@
 
 #include <cfg/compiler.h>
 
+#include <cpu/irq.h>
+
 #include <io/kfile.h>
 
 #include <struct/fifobuf.h>
@@ -56,10 +58,9 @@
 
 /**
  * ADC sample rate.
- * The demodulator filters are designed to work at this frequency.
- * If you need to change this remember to update afsk_adc_isr().
+ * The demodulator filters are derived from this frequency.
  */
-#define SAMPLERATE 9600
+#define SAMPLERATE CONFIG_AFSK_ADC_SAMPLERATE
 
 /**
  * Bitrate of the received/transmitted data.
@@ -82,13 +83,169 @@ typedef struct Hdlc
 	bool rxstart;       ///< True if an HDLC_FLAG char has been found in the bitstream.
 } Hdlc;
 
-//#define FIR_MAX_TAPS 16
-//typedef struct FIR
-//{
-//	int8_t taps;
-//	int8_t coef[FIR_MAX_TAPS];
-//	int16_t mem[FIR_MAX_TAPS];
-//} FIR;
+#define FIR_MAX_TAPS (SAMPLEPERBIT * 2)
+typedef struct FIR
+{
+	int8_t coef[FIR_MAX_TAPS / 2];  ///< First half of the symmetric coefficients
+	int8_t mem[FIR_MAX_TAPS * 2];   ///< Circular delay line, every sample written twice
+	uint8_t idx;                    ///< Position of the last sample in mem[]
+} FIR;
+
+/** Average bit clock error of random edges, see AfskDemod.pll_err */
+#define AFSK_PLL_ERR_NOISE (8 * 64)
+
+/**
+ * Number of demodulators run in parallel on every ADC sample.
+ */
+#define AFSK_DEMODS (CONFIG_AFSK_ENSEMBLE ? CONFIG_AFSK_ENSEMBLE : 1)
+
+#if CONFIG_AFSK_RX_LEVEL
+/** Input samples kept by the level meter, a power of 2 */
+#define AFSK_LEVEL_HIST 16
+#endif
+
+/**
+ * Demodulator context.
+ * Holds the discriminator, bit clock recovery and HDLC state of one
+ * demodulator. The modem runs AFSK_DEMODS of these on the same samples.
+ */
+typedef struct AfskDemod
+{
+	/** Discriminator filter type, one of AFSK_BUTTERWORTH, AFSK_CHEBYSHEV, AFSK_FIR */
+	uint8_t filter;
+
+	/** Slicer threshold, the discriminator output is compared against this */
+	int8_t slice;
+
+	/** IIR filter X cells, used to filter sampled data by the demodulator */
+	int16_t iir_x[2];
+
+	/** IIR filter Y cells, used to filter sampled data by the demodulator */
+	int16_t iir_y[2];
+
+	/**
+	 * Bits sampled by the demodulator are here.
+	 * Since ADC samplerate is higher than the bitrate, the bits here are
+	 * SAMPLEPERBIT times the bitrate.
+	 */
+	uint8_t sampled_bits;
+
+	/**
+	 * Current phase, needed to know when the bitstream at ADC speed
+	 * should be sampled.
+	 */
+#if SAMPLEPERBIT <= 12
+	int8_t curr_phase;
+#else
+	int16_t curr_phase;
+#endif
+
+	/**
+	 * Bit clock PLL: average edge error, in 1/256 of a bit, times 8.
+	 * AFSK_PLL_ERR_NOISE without a signal.
+	 */
+	uint16_t pll_err;
+
+	/** Bits sampled since the last edge */
+	uint8_t pll_bits;
+
+	/** True if the bit clock is locked on a signal */
+	bool pll_locked;
+
+	/** Bits since the last HDLC flag, up to 255 */
+	uint8_t flag_bits;
+
+	/** True from two HDLC flags in a row to DCD_FLAG_BITS after the last one */
+	bool flag_run;
+
+	/** Bits found by the demodulator at the correct bitrate speed. */
+	uint8_t found_bits;
+
+#if CONFIG_AFSK_RX_EQ
+	/** Equalizer: average output on settled mark [0] and space [1] bits, times 16 */
+	int32_t eq_avg[2];
+
+	/** Equalizer: average FIR 1200 [0] and 2200 [1] band level, times 16 */
+	uint16_t eq_lvl[2];
+
+	/** Equalizer: output summed over the current bit */
+	int32_t eq_out;
+
+	/** Equalizer: FIR band levels summed over the current bit */
+	uint16_t eq_sum[2];
+
+	/** Settled mark and space bits since the clock locked, up to EQ_MIN_BITS */
+	uint8_t eq_bits[2];
+
+	/** Slicer offset, towards the midpoint of the mark and space outputs */
+	int16_t eq_center;
+
+	/** Gain of the FIR 2200Hz band, 64 is 1 */
+	uint8_t eq_gain;
+#endif
+
+	/** Hdlc context */
+	Hdlc hdlc;
+
+#if CONFIG_AFSK_ENSEMBLE || CONFIG_AFSK_RX_FRAMES
+	/** Running CRC of the frame being received */
+	uint16_t crc;
+
+	/** Length of the frame being received */
+	uint16_t frm_len;
+#endif
+
+#if CONFIG_AFSK_RX_REPAIR
+	/** Bit index in the frame of the least confident tones */
+	uint16_t rep_pos[CONFIG_AFSK_RX_REPAIR_BITS];
+
+	/** Confidence of the tones in rep_pos */
+	uint8_t rep_conf[CONFIG_AFSK_RX_REPAIR_BITS];
+
+	/** Number of tones in rep_pos */
+	uint8_t rep_cnt;
+
+	/** Confidence of the last tone, 0 if it can not be flipped */
+	uint8_t rep_last;
+#endif
+
+#if CONFIG_AFSK_ENSEMBLE
+	/** Frames first delivered by this demodulator */
+	uint16_t frames;
+
+	/** Frame being received, queued in rx_buf only if its CRC is good */
+	uint8_t frm_buf[CONFIG_AFSK_ENSEMBLE_FRAME_LEN];
+#endif
+} AfskDemod;
+
+#if CONFIG_AFSK_ENSEMBLE
+/**
+ * Signature of a frame recently committed by the ensemble,
+ * used to drop the copies decoded by the other demodulators.
+ */
+typedef struct AfskFrameSig
+{
+	uint16_t fcs;   ///< Frame check sequence, as received
+	uint16_t len;   ///< Frame length
+	uint16_t stamp; ///< Sample clock when the frame was committed
+} AfskFrameSig;
+#endif
+
+#if CONFIG_AFSK_RX_FRAMES
+/**
+ * Descriptor of a received frame held in the rx buffer.
+ */
+typedef struct AfskRxFrame
+{
+	uint16_t start; ///< Offset of the first byte in Afsk.rx_buf
+	uint16_t len;   ///< Frame length, FCS included
+#if CONFIG_AFSK_RX_REPAIR
+	uint16_t crc;   ///< CRC at the end of the frame, AX25_CRC_CORRECT if good
+	uint8_t rep_cnt; ///< Number of tones that can be flipped
+	uint16_t rep_pos[CONFIG_AFSK_RX_REPAIR_BITS]; ///< Bit index of the tones that can be flipped
+#endif
+} AfskRxFrame;
+#endif
 
 /**
  * RX FIFO buffer full error.
@@ -109,8 +266,8 @@ typedef struct Afsk
 	/** DAC channel to be used by the modulator */
 	int dac_ch;
 
-	/** Current sample of bit for output data. */
-	uint8_t sample_count;
+	/** Time left of the bit being modulated, in 1/BITRATE of a DAC sample */
+	uint16_t sample_count;
 
 	/** Current character to be modulated */
 	uint8_t curr_out;
@@ -123,6 +280,20 @@ typedef struct Afsk
 
 	/** Counter for bit stuffing */
 	uint8_t stuff_cnt;
+
+#if CONFIG_AFSK_TX_PREENCODE
+	/** Tones being collected by the encoder, 1 for mark, the first one in the LSB */
+	uint8_t enc_tones;
+
+	/** Number of tones in enc_tones */
+	uint8_t enc_cnt;
+
+	/** Consecutive 1s encoded, for bit stuffing */
+	uint8_t enc_ones;
+
+	/** Last encoded tone, true for mark */
+	bool enc_tone;
+#endif
 	/**
 	 * DDS phase accumulator for generating modulated data.
 	 */
@@ -131,52 +302,132 @@ typedef struct Afsk
 	/** Current phase increment for current modulated bit */
 	uint16_t phase_inc;
 
-	/** Delay line used to delay samples by (SAMPLEPERBIT / 2) */
-	FIFOBuffer delay_fifo;
+#if CONFIG_AFSK_RX_BLOCK
+	/**
+	 * ADC samples waiting for afsk_rxProcess().
+	 * The last (SAMPLEPERBIT / 2) demodulated samples are kept too,
+	 * they are the discriminator delay line.
+	 */
+	int8_t rx_ring[CONFIG_AFSK_RX_BLOCK];
+
+	/** Samples stored by the ADC ISR, free running */
+	volatile uint8_t ring_wr;
+
+	/** Samples demodulated, free running */
+	volatile uint8_t ring_rd;
+
+	/** Samples dropped by the ADC ISR because the ring was full */
+	uint16_t ring_overruns;
+#else
+	/** Circular delay line used to delay samples by (SAMPLEPERBIT / 2) */
+	int8_t delay_buf[SAMPLEPERBIT / 2];
 
+	/** Oldest sample in delay_buf[], replaced by the current one */
+	uint8_t delay_idx;
+#endif
+
+#if CONFIG_AFSK_RX_LEVEL
+	/** Level meter: samples, squares and peak summed over the current window */
+	int32_t lvl_sum;
+	uint32_t lvl_sq;
+	uint8_t lvl_peak;
+	uint16_t lvl_cnt;
+
+	/** Level meter: DC offset, variance and peak of the last window */
+	int8_t lvl_dc;
+	uint16_t lvl_var;
+	uint8_t lvl_max;
+
+	/** Windows measured, free running */
+	volatile uint8_t lvl_windows;
+
+	/** Samples at the ADC limits */
+	uint16_t lvl_clipped;
+
+	/** Squared level summed on the mark [0] and space [1] samples of the frame being received */
+	uint32_t tone_sq[2];
+	uint16_t tone_cnt[2];
+
+	/** Last input levels, DC offset removed, see afsk_levelTone() */
+	uint8_t tone_hist[AFSK_LEVEL_HIST];
+	uint8_t tone_idx;
+
+	/** Same as tone_sq and tone_cnt, for the last decoded frame */
+	uint32_t frame_sq[2];
+	uint16_t frame_cnt[2];
+#endif
+
+#if CONFIG_AFSK_RX_FRAMES
 	/**
-	 * Buffer for delay FIFO.
-	 * The 1 is added because the FIFO macros need
-	 * 1 byte more to handle a buffer (SAMPLEPERBIT / 2) bytes long.
+	 * Buffer holding the received frames, unescaped, back to back.
+	 * A frame is written here while it is being decoded and
+	 * becomes visible to afsk_rxFrame() only when its CRC is good.
 	 */
-	int8_t delay_buf[SAMPLEPERBIT / 2 + 1];
+	uint8_t rx_buf[CONFIG_AFSK_RX_BUFLEN];
+
+	/** Queue of the complete frames held in rx_buf */
+	AfskRxFrame rx_frames[CONFIG_AFSK_RX_FRAMES];
 
+	/** Next frame to be read */
+	uint8_t rx_head;
+
+	/** Number of frames in the queue */
+	volatile uint8_t rx_cnt;
+
+	/** Offset in rx_buf of the frame being received */
+	uint16_t rx_start;
+
+	/** Write offset in rx_buf */
+	uint16_t rx_wr;
+
+	/** Bytes of the frame being received */
+	uint16_t rx_cur;
+#else
 	/** FIFO for received data */
 	FIFOBuffer rx_fifo;
 
 	/** FIFO rx buffer */
 	uint8_t rx_buf[CONFIG_AFSK_RX_BUFLEN];
+#endif
 
 	/** FIFO for transmitted data */
 	FIFOBuffer tx_fifo;
 
-	/** FIFO tx buffer */
+	/** FIFO tx buffer, holds the tones with CONFIG_AFSK_TX_PREENCODE */
 	uint8_t tx_buf[CONFIG_AFSK_TX_BUFLEN];
 
-	/** IIR filter X cells, used to filter sampled data by the demodulator */
-	int16_t iir_x[2];
+	/** Demodulators fed with the same samples */
+	AfskDemod demod[AFSK_DEMODS];
 
-	/** IIR filter Y cells, used to filter sampled data by the demodulator */
-	int16_t iir_y[2];
+#if CONFIG_AFSK_ENSEMBLE
+	/** Free running sample counter, used to age the frame signatures */
+	uint16_t sample_clock;
 
-	/**
-	 * Bits sampled by the demodulator are here.
-	 * Since ADC samplerate is higher than the bitrate, the bits here are
-	 * SAMPLEPERBIT times the bitrate.
-	 */
-	uint8_t sampled_bits;
+	/** Signatures of the last frames queued in rx_buf */
+	AfskFrameSig recent[CONFIG_AFSK_ENSEMBLE_DEDUP];
 
-	bool cd;
-	uint8_t cd_state;
+	/** Next entry to be replaced in recent[] */
+	uint8_t recent_idx;
 
-	/**
-	 * Current phase, needed to know when the bitstream at ADC speed
-	 * should be sampled.
-	 */
-	int8_t curr_phase;
+	/** Duplicated frames dropped by the ensemble */
+	uint16_t dups;
+#endif
 
-	/** Bits found by the demodulator at the correct bitrate speed. */
-	uint8_t found_bits;
+#if CONFIG_AFSK_ENSEMBLE || CONFIG_AFSK_RX_FRAMES
+	/** Frames dropped by the modem because of a bad CRC */
+	uint16_t crc_errors;
+#endif
+
+#if CONFIG_AFSK_RX_REPAIR
+	/** Frames with a bad CRC repaired by flipping their least confident tones */
+	uint16_t repaired;
+#endif
+
+	/** Data carrier detect, see afsk_dcd() */
+	volatile bool dcd;
+
+	/** Bits left before the data carrier detect is released */
+	uint8_t dcd_hold;
 
 	/** True while modem sends data */
 	volatile bool sending;
@@ -187,9 +438,6 @@ typedef struct Afsk
 	 */
 	volatile int status;
 
-	/** Hdlc context */
-	Hdlc hdlc;
-
 	/**
 	 * Preamble length.
 	 * When the AFSK modem wants to send data, before sending the actual data,
@@ -205,6 +453,24 @@ typedef struct Afsk
 	 * This helps to synchronize the demodulator filters on the receiver side.
 	 */
 	uint16_t trailer_len;
+
+	/** Preamble length of the next transmissions, in HDLC_FLAG characters */
+	uint16_t preamble_flags;
+
+	/** Trailer length of the next transmissions, in HDLC_FLAG characters */
+	uint16_t trailer_flags;
+
+	/** Frames sent since the transmitter was keyed up */
+	uint8_t keyup_frames;
+
+	/** Characters sent since the transmitter was keyed up, preamble included */
+	uint16_t keyup_len;
+
+	/** True if the last written character was an AX25_ESC */
+	bool tx_esc;
+
+	/** True while the written characters belong to a frame */
+	bool tx_inframe;
 } Afsk;
 
 #define KFT_AFSK MAKE_ID('A', 'F', 'S', 'K')
@@ -216,9 +482,151 @@ INLINE Afsk *AFSK_CAST(KFile *fd)
 }
 
 
+/**
+ * \return true if the bit clock of any demodulator is locked on a signal.
+ */
+INLINE bool afsk_rxLocked(Afsk *af)
+{
+	for (int i = 0; i < AFSK_DEMODS; i++)
+		if (af->demod[i].pll_locked)
+			return true;
+	return false;
+}
+
+/**
+ * Lock quality of the bit clock of the first demodulator,
+ * from 0 (random edges, no signal) to 255 (edges exactly on time).
+ */
+INLINE uint8_t afsk_rxLockQuality(Afsk *af)
+{
+	uint16_t err;
+
+	ATOMIC(err = af->demod[0].pll_err);
+
+	return (err >= AFSK_PLL_ERR_NOISE) ? 0 : 255 - err / 2;
+}
+
+#if CONFIG_AFSK_RX_EQ
+/**
+ * Receive equalizer estimates, see afsk_rxEq().
+ */
+typedef struct AfskEqStats
+{
+	int16_t mark;   ///< Demodulator output on mark bits
+	int16_t space;  ///< Demodulator output on space bits
+	int16_t center; ///< Slicer offset, the tone centroid
+	uint8_t gain;   ///< FIR 2200Hz band gain, 64 is 1
+} AfskEqStats;
+
+void afsk_rxEq(Afsk *af, AfskEqStats *eq);
+#endif
+
+#if CONFIG_AFSK_RX_FRAMES
+/**
+ * Get the oldest received frame, FCS included, in place in the modem
+ * buffer, without blocking.
+ * The frame can be changed and grown up to \a size bytes, it stays
+ * there until afsk_rxFrameDone(): the modem queues the next frames
+ * meanwhile.
+ * \param len set to the frame length.
+ * \param size set to the room for the frame, CONFIG_AFSK_RX_ROOM bytes more.
+ * \return the frame, NULL if there is none.
+ */
+uint8_t *afsk_rxFrame(Afsk *af, size_t *len, size_t *size);
+
+/**
+ * Release the frame returned by afsk_rxFrame().
+ */
+void afsk_rxFrameDone(Afsk *af);
+#endif
+
+#if CONFIG_AFSK_ENSEMBLE
+/**
+ * Ensemble counters, see afsk_rxEnsemble().
+ */
+typedef struct AfskEnsembleStats
+{
+	uint16_t dups;                           ///< Copies of delivered frames dropped
+	uint16_t frames[CONFIG_AFSK_ENSEMBLE];   ///< Frames first delivered by each demodulator
+} AfskEnsembleStats;
+
+void afsk_rxEnsemble(Afsk *af, AfskEnsembleStats *st);
+#endif
+
+#if CONFIG_AFSK_RX_LEVEL
+/**
+ * Receive audio levels, see afsk_rxLevel().
+ * All of them in ADC units, the samples span from -128 to 127.
+ */
+typedef struct AfskLevelStats
+{
+	int8_t dc;        ///< DC offset of the input
+	uint8_t rms;      ///< RMS of the input, DC offset removed
+	uint8_t peak;     ///< Peak of the input
+	uint16_t clipped; ///< Samples at the ADC limits
+	uint8_t mark;     ///< RMS on the mark tone of the last decoded frame
+	uint8_t space;    ///< RMS on the space tone of the last decoded frame
+} AfskLevelStats;
+
+void afsk_rxLevel(Afsk *af, AfskLevelStats *lvl);
+void afsk_rxLevelReset(Afsk *af);
+
+/**
+ * \return the number of level windows measured, free running: the
+ *         levels returned by afsk_rxLevel() change when this does.
+ */
+INLINE uint8_t afsk_rxLevelWindows(Afsk *af)
+{
+	return af->lvl_windows;
+}
+#endif
+
+/**
+ * \return true if any demodulator is in the middle of a frame
+ *         or has its bit clock locked on a signal.
+ */
+INLINE bool afsk_rxBusy(Afsk *af)
+{
+	for (int i = 0; i < AFSK_DEMODS; i++)
+		if (af->demod[i].hdlc.rxstart || af->demod[i].pll_locked)
+			return true;
+	return false;
+}
+
+/**
+ * Data carrier detect, for the channel access.
+ * \return true while a demodulator has its bit clock locked on a signal
+ *         or receives HDLC flags, and for CONFIG_AFSK_DCD_HOLD after.
+ *         Voice and noise do not trigger it.
+ */
+INLINE bool afsk_dcd(Afsk *af)
+{
+	return af->dcd;
+}
+
 void afsk_adc_isr(Afsk *af, int8_t sample);
+#if CONFIG_AFSK_RX_BLOCK
+void afsk_rxProcess(Afsk *af);
+
+/**
+ * \return the number of samples dropped because the sample ring was full,
+ *         counted by the ADC ISR.
+ */
+INLINE uint16_t afsk_rxRingOverruns(Afsk *af)
+{
+	uint16_t n;
+
+	ATOMIC(n = af->ring_overruns);
+	return n;
+}
+#else
+/* The samples are demodulated by afsk_adc_isr() */
+INLINE void afsk_rxProcess(UNUSED_ARG(Afsk *, af)) { }
+#endif
 uint8_t afsk_dac_isr(Afsk *af);
 void afsk_init(Afsk *af, int adc_ch, int dac_ch);
+void afsk_setTiming(Afsk *af, uint16_t preamble_ms, uint16_t trailer_ms);
+bool afsk_txBundleOk(Afsk *af);
 
 int afsk_testSetup(void);
 int afsk_testRun(void);
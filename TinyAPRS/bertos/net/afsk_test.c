@@ -66,10 +66,10 @@ AX25Ctx ax25;
 KFileDebug dbg;
 
 int msg_cnt;
-static void message_hook(struct AX25Msg *msg)
+static void message_hook(struct AX25View *frm)
 {
 	msg_cnt++;
-	ax25_print(&dbg.fd, msg);
+	ax25_print(&dbg.fd, frm);
 }
 
 static FILE *afsk_fileOpen(const char *name)
@@ -152,17 +152,18 @@ int afsk_testSetup(void)
 }
 
 
-static void messageout_hook(struct AX25Msg *msg)
+static void messageout_hook(struct AX25View *frm)
 {
-	ASSERT(strncmp(msg->dst.call, "ABCDEF", 6) == 0);
-	ASSERT(strncmp(msg->src.call, "123456", 6) == 0);
-	ASSERT(msg->src.ssid == 1);
-	ASSERT(msg->dst.ssid == 0);
-	ASSERT(msg->ctrl == AX25_CTRL_UI);
-	ASSERT(msg->pid == AX25_PID_NOLAYER3);
-	ASSERT(msg->len == 256);
+	static const AX25Call dst = AX25_CALL("ABCDEF", 0);
+	static const AX25Call src = AX25_CALL("123456", 1);
+
+	/* Only UI frames with no layer 3 have addresses */
+	ASSERT(frm->addr_cnt == 2);
+	ASSERT(ax25_addrIsCall(ax25_viewAddr(frm, AX25_ADDR_DST), &dst));
+	ASSERT(ax25_addrIsCall(ax25_viewAddr(frm, AX25_ADDR_SRC), &src));
+	ASSERT(frm->info_len == 256);
 	for (int i = 0; i < 256; i++)
-		ASSERT(msg->info[i] == i);
+		ASSERT(frm->info[i] == i);
 }
 
 int afsk_testRun(void)
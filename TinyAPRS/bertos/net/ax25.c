@@ -55,80 +55,79 @@
 
 #include <cpu/irq.h>
 
-/*
- * Decode the CALL field, assume addr is a fix-size array
- */
-#define DECODE_CALL(buf, addr) \
-	for (unsigned i = 0; i < sizeof((addr)); i++) \
-	{ \
-		char c = (*(buf)++ >> 1); \
-		(addr)[i] = (c == ' ') ? '\x0' : c; \
-	}
+#if CONFIG_AX25_FRAMED_RX
+	#include <net/afsk.h>
+#endif
 
 /*
- * The decoded ax25 frame contains:
- * | DST_ID(7) |SRC_ID(7) | RPT_LIST(7 * 8) | CTRL(0x03) | PID(0xF0) | PAYLOAD | LEN |
+ * Set up the view of a frame:
+ * | DST(7) | SRC(7) | RPT(7 * 0..8) | CTRL(0x03) | PID(0xF0) | PAYLOAD |
+ * The address field ends with the address with the last bit set.
+ * Return false if the frame is not an UI frame with no layer 3:
+ * the view holds only the frame buffer then.
  */
-static void ax25_decode(AX25Ctx *ctx)
+static bool ax25_view(AX25View *frm, uint8_t *buf, size_t len, size_t size)
 {
-	AX25Msg msg;
-	uint8_t *buf = ctx->buf;
-
-	DECODE_CALL(buf, msg.dst.call);
-	msg.dst.ssid = (*buf++ >> 1) & 0x0F;
+	size_t i;
 
-	DECODE_CALL(buf, msg.src.call);
-	msg.src.ssid = (*buf >> 1) & 0x0F;
+	frm->buf = buf;
+	frm->len = len;
+	frm->size = size;
+	frm->addr_cnt = 0;
+	frm->info = NULL;
+	frm->info_len = 0;
 
-	LOG_INFO("SRC[%.6s-%d], DST[%.6s-%d]\n", msg.src.call, msg.src.ssid, msg.dst.call, msg.dst.ssid);
-
-	/* Repeater addresses */
-	#if CONFIG_AX25_RPT_LST
-		for (msg.rpt_cnt = 0; !(*buf++ & 0x01) && (msg.rpt_cnt < countof(msg.rpt_lst)); msg.rpt_cnt++)
-		{
-			DECODE_CALL(buf, msg.rpt_lst[msg.rpt_cnt].call);
-			msg.rpt_lst[msg.rpt_cnt].ssid = (*buf >> 1) & 0x0F;
-			AX25_SET_REPEATED(&msg, msg.rpt_cnt, (*buf & 0x80));
-
-			LOG_INFO("RPT%d[%.6s-%d]%c\n", msg.rpt_cnt, 
-				msg.rpt_lst[msg.rpt_cnt].call, 
-				msg.rpt_lst[msg.rpt_cnt].ssid,
-				(AX25_REPEATED(&msg, msg.rpt_cnt) ? '*' : ' '));
-		}
-	#else
-		while (!(*buf++ & 0x01))
-		{
-			char rpt[6];
-			uint8_t ssid;
-			DECODE_CALL(buf, rpt);
-			ssid = (*buf >> 1) & 0x0F;
-			LOG_INFO("RPT[%.6s-%d]\n", rpt, ssid);
-		}
-	#endif
+	for (i = 0; i + AX25_ADDR_LEN <= len; )
+	{
+		i += AX25_ADDR_LEN;
+		if (buf[i - 1] & AX25_SSID_LAST)
+			break;
+	}
 
-	msg.ctrl = *buf++;
-	if (msg.ctrl != AX25_CTRL_UI)
+	if (!i || !(buf[i - 1] & AX25_SSID_LAST) || i < AX25_ADDR_RPT * AX25_ADDR_LEN
+		|| i > (AX25_ADDR_RPT + AX25_MAX_RPT) * AX25_ADDR_LEN || i + 2 > len)
 	{
-		LOG_WARN("Only UI frames are handled, got [%02X]\n", msg.ctrl);
-		return;
+		LOG_WARN("Bad address field\n");
+		return false;
 	}
 
-	msg.pid = *buf++;
-	if (msg.pid != AX25_PID_NOLAYER3)
+	if (buf[i] != AX25_CTRL_UI)
 	{
-		LOG_WARN("Only frames without layer3 protocol are handled, got [%02X]\n", msg.pid);
-		return;
+		LOG_WARN("Only UI frames are handled, got [%02X]\n", buf[i]);
+		return false;
 	}
 
-	msg.len = ctx->frm_len - 2 - (buf - ctx->buf);
-	msg.info = buf;
-	LOG_INFO("DATA: %.*s\n", msg.len, msg.info);
+	if (buf[i + 1] != AX25_PID_NOLAYER3)
+	{
+		LOG_WARN("Only frames without layer3 protocol are handled, got [%02X]\n", buf[i + 1]);
+		return false;
+	}
 
-	if (ctx->hook)
-		ctx->hook(&msg);
+	frm->addr_cnt = i / AX25_ADDR_LEN;
+	frm->info = buf + i + 2;
+	frm->info_len = len - i - 2;
+	LOG_INFO("DATA: %.*s\n", frm->info_len, frm->info);
+	return true;
 }
 
 
+/**
+ * Hand the good frame \a buf, \a len bytes long FCS included, to the user.
+ * The frame can grow in place up to \a size bytes.
+ * In pass through mode every frame is handed over, UI or not.
+ */
+static void ax25_frameFound(AX25Ctx *ctx, uint8_t *buf, size_t len, size_t size)
+{
+	AX25View frm;
+
+	LOG_INFO("Frame found!\n");
+#if CONFIG_AX25_STAT
+	ATOMIC(ctx->stat.rx_ok++);
+#endif
+	if ((ax25_view(&frm, buf, len - 2, size - 2) || ctx->pass_through) && ctx->hook)
+		ctx->hook(&frm);
+}
+
 /**
  * Check if there are any AX25 messages to be processed.
  * This function read available characters from the medium and search for
@@ -141,6 +140,19 @@ static void ax25_decode(AX25Ctx *ctx)
  */
 void ax25_poll(AX25Ctx *ctx)
 {
+#if CONFIG_AX25_FRAMED_RX
+	Afsk *af = AFSK_CAST(ctx->ch);
+	uint8_t *buf;
+	size_t len, size;
+
+	/* Whole frames, already checked by the modem, viewed in its buffer */
+	while ((buf = afsk_rxFrame(af, &len, &size)) != NULL)
+	{
+		if (len >= AX25_MIN_FRAME_LEN)
+			ax25_frameFound(ctx, buf, len, size);
+		afsk_rxFrameDone(af);
+	}
+#else
 	int c;
 
 	while ((c = kfile_getc(ctx->ch)) != EOF)
@@ -150,20 +162,7 @@ void ax25_poll(AX25Ctx *ctx)
 			if (ctx->frm_len >= AX25_MIN_FRAME_LEN)
 			{
 				if (ctx->crc_in == AX25_CRC_CORRECT)
-				{
-					LOG_INFO("Frame found!\n");
-#if CONFIG_AX25_STAT
-					ATOMIC(ctx->stat.rx_ok++);
-#endif
-					if (ctx->pass_through) {
-						if (ctx->hook) {
-							//TODO: make MSG union and pass to hook
-							ctx->hook(NULL);
-						}
-					} else {
-						ax25_decode(ctx);
-					}
-				}
+					ax25_frameFound(ctx, ctx->buf, ctx->frm_len, sizeof(ctx->buf));
 				else
 				{
 					LOG_INFO("CRC error, computed [%04X]\n", ctx->crc_in);
@@ -223,6 +222,7 @@ void ax25_poll(AX25Ctx *ctx)
 		}
 		ctx->escape = false;
 	}
+#endif
 
 	if (kfile_error(ctx->ch))
 	{
@@ -237,206 +237,302 @@ void ax25_poll(AX25Ctx *ctx)
 	}
 }
 
-void ax25_putchar(AX25Ctx *ctx, uint8_t c)
+/**
+ * Start building a frame.
+ * The frame is written to the channel by ax25_frameEnd(), with a single
+ * kfile_write() if \a buf holds all of it (\see AX25_FRAME_BUF_SIZE),
+ * otherwise every time the buffer fills up.
+ *
+ * \param ctx AX25 context the frame is sent to.
+ * \param frm frame to build.
+ * \param buf frame buffer, at least AX25_FRAME_BUF_MIN bytes long.
+ * \param size size of \a buf.
+ */
+void ax25_frameStart(AX25Ctx *ctx, AX25Frame *frm, uint8_t *buf, size_t size)
 {
-	if (c == HDLC_FLAG || c == HDLC_RESET
-		|| c == AX25_ESC)
-		kfile_putc(AX25_ESC, ctx->ch);
-	ctx->crc_out = updcrc_ccitt(c, ctx->crc_out);
-	kfile_putc(c, ctx->ch);
+	ASSERT(size >= AX25_FRAME_BUF_MIN);
+
+	frm->ctx = ctx;
+	frm->buf = buf;
+	frm->size = size;
+	frm->buf[0] = HDLC_FLAG;
+	frm->len = 1;
+	frm->crc = CRC_CCITT_INIT_VAL;
 }
 
-static void ax25_sendCall(AX25Ctx *ctx, const AX25Call *addr, bool last,bool repeated)
+/*
+ * Make room for \a len more bytes in the frame buffer, writing out
+ * the frame built so far if needed.
+ */
+INLINE void ax25_frameRoom(AX25Frame *frm, size_t len)
 {
-	unsigned len = MIN(sizeof(addr->call), strlen(addr->call));
-
-	for (unsigned i = 0; i < len; i++)
+	if (frm->len + len > frm->size)
 	{
-		uint8_t c = addr->call[i];
-		ASSERT(isalnum(c) || c == ' ');
-		c = toupper(c);
-		ax25_putchar(ctx, c << 1);
+		kfile_write(frm->ctx->ch, frm->buf, frm->len);
+		frm->len = 0;
 	}
+}
 
-	/* Fill with spaces the rest of the CALL if it's shorter */
-	if (len < sizeof(addr->call))
-		for (unsigned i = 0; i < sizeof(addr->call) - len; i++)
-			ax25_putchar(ctx, ' ' << 1);
+/* Copy the frame contents in the frame buffer, HDLC escaped */
+static void ax25_frameCopy(AX25Frame *frm, const uint8_t *buf, size_t len)
+{
+	while (len--)
+	{
+		uint8_t c = *buf++;
 
-	/* The bit7 "has-been-repeated" flag is not implemented here */
-	/* Bits6:5 should be set to 1 for all SSIDs (0x60) */
-	/* The bit0 of last call SSID should be set to 1 */
-	uint8_t ssid = 0x60 | (addr->ssid << 1) | (last ? 0x01 : 0);
-	if(repeated) ssid |= 0x80;
-	ax25_putchar(ctx, ssid);
+		ax25_frameRoom(frm, 2);
+		if (c == HDLC_FLAG || c == HDLC_RESET || c == AX25_ESC)
+			frm->buf[frm->len++] = AX25_ESC;
+		frm->buf[frm->len++] = c;
+	}
 }
 
 /**
- * Send an AX25 frame on the channel through a specific path.
- * \param ctx AX25 context to operate on.
- * \param path An array of callsigns used as path, \see AX25_PATH for
- *        an handy way to create a path.
- * \param path_len callsigns path lenght.
- * \param _buf payload buffer.
- * \param len length of the payload.
+ * Add \a len bytes to the contents of the frame.
+ * \param frm frame being built.
+ * \param _buf bytes to add.
+ * \param len number of bytes.
  */
-void ax25_sendVia(AX25Ctx *ctx, const AX25Call *path, size_t path_len, const void *_buf, size_t len)
+void ax25_framePut(AX25Frame *frm, const void *_buf, size_t len)
 {
 	const uint8_t *buf = (const uint8_t *)_buf;
-	ASSERT(path);
-	ASSERT(path_len >= 2);
 
-	ctx->crc_out = CRC_CCITT_INIT_VAL;
-	kfile_putc(HDLC_FLAG, ctx->ch);
+	frm->crc = crc_ccitt(frm->crc, buf, len);
+	ax25_frameCopy(frm, buf, len);
+}
 
+/**
+ * Add an address to the frame.
+ * \param frm frame being built.
+ * \param addr callsign and SSID.
+ * \param last true for the last address of the frame.
+ * \param repeated has-been-repeated flag, for the repeater addresses.
+ */
+void ax25_frameCall(AX25Frame *frm, const AX25Call *addr, bool last, bool repeated)
+{
+	uint8_t enc[AX25_ADDR_LEN];
 
-	/* Send call */
-	for (size_t i = 0; i < path_len; i++)
-		ax25_sendCall(ctx, &path[i], (i == path_len - 1), false /*repeated is not implemented*/);
+	ax25_addrEncode(enc, addr);
+	/* The bit0 of last call SSID should be set to 1 */
+	if (last)
+		enc[AX25_ADDR_LEN - 1] |= AX25_SSID_LAST;
+	if (repeated)
+		enc[AX25_ADDR_LEN - 1] |= AX25_SSID_REPEATED;
 
-	ax25_putchar(ctx, AX25_CTRL_UI);
-	ax25_putchar(ctx, AX25_PID_NOLAYER3);
+	ax25_framePut(frm, enc, sizeof(enc));
+}
 
-	while (len--)
-		ax25_putchar(ctx, *buf++);
+/**
+ * Add the control and PID fields of an UI frame with no layer 3.
+ */
+void ax25_frameUI(AX25Frame *frm)
+{
+	static const uint8_t ui[] = { AX25_CTRL_UI, AX25_PID_NOLAYER3 };
+
+	ax25_framePut(frm, ui, sizeof(ui));
+}
 
+/**
+ * Add the FCS and the closing flag to the frame and write it out.
+ * \param frm frame being built, a new one must be started after this.
+ */
+void ax25_frameEnd(AX25Frame *frm)
+{
 	/*
 	 * According to AX25 protocol,
 	 * CRC is sent in reverse order!
 	 */
-	uint8_t crcl = (ctx->crc_out & 0xff) ^ 0xff;
-	uint8_t crch = (ctx->crc_out >> 8) ^ 0xff;
-	ax25_putchar(ctx, crcl);
-	ax25_putchar(ctx, crch);
+	uint8_t fcs[2];
+	fcs[0] = (frm->crc & 0xff) ^ 0xff;
+	fcs[1] = (frm->crc >> 8) ^ 0xff;
 
-	ASSERT(ctx->crc_out == AX25_CRC_CORRECT);
+	ASSERT(crc_ccitt(frm->crc, fcs, sizeof(fcs)) == AX25_CRC_CORRECT);
 
-	// flush
-	kfile_putc(HDLC_FLAG, ctx->ch);
+	ax25_frameCopy(frm, fcs, sizeof(fcs));
+	ax25_frameRoom(frm, 1);
+	frm->buf[frm->len++] = HDLC_FLAG;
+	kfile_write(frm->ctx->ch, frm->buf, frm->len);
+	frm->len = 0;
 
 #if CONFIG_AX25_STAT
-	ATOMIC(ctx->stat.tx_ok++);
+	ATOMIC(frm->ctx->stat.tx_ok++);
 #endif
 }
 
-void ax25_sendMsg(AX25Ctx *ctx, const AX25Msg *msg){
-	if(msg->rpt_cnt == 0 || msg->len == 0){
-		return;
-	}
-	const uint8_t *buf = msg->info;
-	size_t len = msg->len;
-
-	ctx->crc_out = CRC_CCITT_INIT_VAL;
-	kfile_putc(HDLC_FLAG, ctx->ch);
-
-	// Send dest call
-	ax25_sendCall(ctx, &(msg->dst), false, false);
-	// send src call
-	ax25_sendCall(ctx, &(msg->src), false, false);
+/**
+ * Send an AX25 frame on the channel through a specific path.
+ * \param ctx AX25 context to operate on.
+ * \param path An array of callsigns used as path, \see AX25_PATH for
+ *        an handy way to create a path.
+ * \param path_len callsigns path lenght.
+ * \param _buf payload buffer.
+ * \param len length of the payload.
+ */
+void ax25_sendVia(AX25Ctx *ctx, const AX25Call *path, size_t path_len, const void *_buf, size_t len)
+{
+	uint8_t buf[CONFIG_AX25_TX_BUF_LEN];
+	AX25Frame frm;
 
-	/* Send path calls */
-	for (uint8_t i = 0; i < msg->rpt_cnt; i++){
-		ax25_sendCall(ctx, msg->rpt_lst + i, (i == msg->rpt_cnt - 1),AX25_REPEATED(msg,i));
-	}
+	ASSERT(path);
+	ASSERT(path_len >= 2);
 
-	ax25_putchar(ctx, AX25_CTRL_UI);
-	ax25_putchar(ctx, AX25_PID_NOLAYER3);
+	ax25_frameStart(ctx, &frm, buf, sizeof(buf));
+	for (size_t i = 0; i < path_len; i++)
+		ax25_frameCall(&frm, &path[i], (i == path_len - 1), false /*repeated is not implemented*/);
+	ax25_frameUI(&frm);
+	ax25_framePut(&frm, _buf, len);
+	ax25_frameEnd(&frm);
+}
 
-	while (len--)
-		ax25_putchar(ctx, *buf++);
+void ax25_sendRaw(AX25Ctx *ctx, const void *_buf, size_t len)
+{
+	uint8_t buf[CONFIG_AX25_TX_BUF_LEN];
+	AX25Frame frm;
 
-	/*
-	 * According to AX25 protocol,
-	 * CRC is sent in reverse order!
-	 */
-	uint8_t crcl = (ctx->crc_out & 0xff) ^ 0xff;
-	uint8_t crch = (ctx->crc_out >> 8) ^ 0xff;
-	ax25_putchar(ctx, crcl);
-	ax25_putchar(ctx, crch);
+	ax25_frameStart(ctx, &frm, buf, sizeof(buf));
+	ax25_framePut(&frm, _buf, len);
+	ax25_frameEnd(&frm);
+}
 
-	ASSERT(ctx->crc_out == AX25_CRC_CORRECT);
+/**
+ * Encode a callsign in the on-air form of an address field.
+ * The last and has-been-repeated flags are left clear.
+ * \param addr address field, AX25_ADDR_LEN bytes.
+ * \param call callsign and SSID.
+ */
+void ax25_addrEncode(uint8_t *addr, const AX25Call *call)
+{
+	unsigned len = MIN(sizeof(call->call), strlen(call->call));
 
-	kfile_putc(HDLC_FLAG, ctx->ch);
+	for (unsigned i = 0; i < len; i++)
+	{
+		uint8_t c = call->call[i];
+		ASSERT(isalnum(c) || c == ' ');
+		addr[i] = toupper(c) << 1;
+	}
 
-	// flush the channel, wait the radio send off
-	kfile_flush(ctx->ch);
+	/* Fill with spaces the rest of the CALL if it's shorter */
+	for (unsigned i = len; i < sizeof(call->call); i++)
+		addr[i] = ' ' << 1;
 
-#if CONFIG_AX25_STAT
-	ATOMIC(ctx->stat.tx_ok++);
-#endif
+	/* Bits6:5 should be set to 1 for all SSIDs (0x60) */
+	addr[sizeof(call->call)] = AX25_SSID_RESERVED | (call->ssid << 1);
 }
 
-void ax25_sendRaw(AX25Ctx *ctx, const void *_buf, size_t len)
+/**
+ * Decode an address field, the trailing spaces of the callsign
+ * are cleared.
+ */
+void ax25_addrDecode(const uint8_t *addr, AX25Call *call)
 {
-	const uint8_t *buf = (const uint8_t *)_buf;
-
-	ctx->crc_out = CRC_CCITT_INIT_VAL;
-	kfile_putc(HDLC_FLAG, ctx->ch);
-
-	while (len--)
-		ax25_putchar(ctx, *buf++);
+	for (unsigned i = 0; i < sizeof(call->call); i++)
+	{
+		char c = addr[i] >> 1;
+		call->call[i] = (c == ' ') ? '\x0' : c;
+	}
+	call->ssid = ax25_addrSsid(addr);
+}
 
-	/*
-	 * According to AX25 protocol,
-	 * CRC is sent in reverse order!
-	 */
-	uint8_t crcl = (ctx->crc_out & 0xff) ^ 0xff;
-	uint8_t crch = (ctx->crc_out >> 8) ^ 0xff;
-	ax25_putchar(ctx, crcl);
-	ax25_putchar(ctx, crch);
+/**
+ * Check if an address field holds a callsign, the flags are not compared.
+ * The callsign is shifted to the on-air form, the address is not decoded.
+ */
+bool ax25_addrIsCall(const uint8_t *addr, const AX25Call *call)
+{
+	uint8_t enc[AX25_ADDR_LEN];
 
-	ASSERT(ctx->crc_out == AX25_CRC_CORRECT);
+	ax25_addrEncode(enc, call);
+	return memcmp(addr, enc, AX25_ADDR_LEN - 1) == 0
+		&& ((addr[AX25_ADDR_LEN - 1] ^ enc[AX25_ADDR_LEN - 1]) & AX25_SSID_MASK) == 0;
+}
 
-	kfile_putc(HDLC_FLAG, ctx->ch);
+/**
+ * Replace the address field \a idx of a frame, in place.
+ * The last address flag is kept.
+ * \param frm frame to edit.
+ * \param idx address field, \see AX25_ADDR_DST.
+ * \param call new callsign and SSID.
+ * \param repeated has-been-repeated flag, for the repeater addresses.
+ */
+void ax25_viewSetAddr(AX25View *frm, uint8_t idx, const AX25Call *call, bool repeated)
+{
+	uint8_t *addr = ax25_viewAddr(frm, idx);
+	uint8_t last = addr[AX25_ADDR_LEN - 1] & AX25_SSID_LAST;
 
-	// flush the channel, wait the radio send off
-	kfile_flush(ctx->ch);
+	ax25_addrEncode(addr, call);
+	addr[AX25_ADDR_LEN - 1] |= last | (repeated ? AX25_SSID_REPEATED : 0);
+}
 
-#if CONFIG_AX25_STAT
-	ATOMIC(ctx->stat.tx_ok++);
-#endif
+/**
+ * Insert an address field in a frame, in place: the field \a idx
+ * is duplicated, the fields after it and the payload move up by
+ * AX25_ADDR_LEN bytes. The copy at \a idx is not the last address.
+ * \param frm frame to edit.
+ * \param idx address field to duplicate, \see AX25_ADDR_DST.
+ * \return false if the frame would not fit in its buffer, or have
+ *         more than AX25_MAX_RPT repeaters.
+ */
+bool ax25_viewInsertAddr(AX25View *frm, uint8_t idx)
+{
+	uint8_t *addr = ax25_viewAddr(frm, idx);
+
+	if (frm->addr_cnt >= AX25_ADDR_RPT + AX25_MAX_RPT
+		|| frm->len + AX25_ADDR_LEN > frm->size)
+		return false;
+
+	memmove(addr + AX25_ADDR_LEN, addr, frm->buf + frm->len - addr);
+	addr[AX25_ADDR_LEN - 1] &= ~AX25_SSID_LAST;
+	frm->len += AX25_ADDR_LEN;
+	frm->addr_cnt++;
+	frm->info += AX25_ADDR_LEN;
+	return true;
 }
 
-static void print_call(KFile *ch, const AX25Call *call)
+static void print_addr(KFile *ch, const uint8_t *addr)
 {
+	AX25Call call;
+
+	ax25_addrDecode(addr, &call);
 #if CPU_AVR
-	kfile_printf_P(ch, PSTR("%.6s"), call->call);
-	if (call->ssid)
-		kfile_printf_P(ch, PSTR("-%d"), call->ssid);
+	kfile_printf_P(ch, PSTR("%.6s"), call.call);
+	if (call.ssid)
+		kfile_printf_P(ch, PSTR("-%d"), call.ssid);
 #else
-	kfile_printf(ch, "%.6s", call->call);
-	if (call->ssid)
-		kfile_printf(ch, "-%d", call->ssid);
+	kfile_printf(ch, "%.6s", call.call);
+	if (call.ssid)
+		kfile_printf(ch, "-%d", call.ssid);
 #endif
 }
 
 /**
  * Print a AX25 message in TNC-2 packet monitor format.
  * \param ch a kfile channel where the message will be printed.
- * \param msg the message to be printed.
+ * \param frm the UI frame to be printed.
  */
-void ax25_print(KFile *ch, const AX25Msg *msg)
+void ax25_print(KFile *ch, const AX25View *frm)
 {
-	print_call(ch, &msg->src);
+	ASSERT(frm->addr_cnt);
+
+	print_addr(ch, ax25_viewAddr(frm, AX25_ADDR_SRC));
 	kfile_putc('>', ch);
-	print_call(ch, &msg->dst);
+	print_addr(ch, ax25_viewAddr(frm, AX25_ADDR_DST));
 
-	#if CONFIG_AX25_RPT_LST
-	for (int i = 0; i < msg->rpt_cnt; i++)
+	for (uint8_t i = AX25_ADDR_RPT; i < frm->addr_cnt; i++)
 	{
+		const uint8_t *rpt = ax25_viewAddr(frm, i);
+
 		kfile_putc(',', ch);
-		print_call(ch, &msg->rpt_lst[i]);
-		/* Print a '*' if packet has already been transmitted 
+		print_addr(ch, rpt);
+		/* Print a '*' if packet has already been transmitted
 		 * by this repeater */
-		if (AX25_REPEATED(msg, i))
+		if (ax25_addrRepeated(rpt))
 			kfile_putc('*', ch);
 	}
-	#endif
 
 #if CPU_AVR
-	kfile_printf_P(ch, PSTR(":%.*s\n\r"), msg->len, msg->info);
+	kfile_printf_P(ch, PSTR(":%.*s\n\r"), frm->info_len, frm->info);
 #else
-	kfile_printf_P(ch, ":%.*s\n\r", msg->len, msg->info);
+	kfile_printf_P(ch, ":%.*s\n\r", frm->info_len, frm->info);
 #endif
 }
 
@@ -456,9 +552,11 @@ void ax25_init(AX25Ctx *ctx, KFile *channel, ax25_callback_t hook)
 	memset(ctx, 0, sizeof(*ctx));
 	ctx->ch = channel;
 	ctx->hook = hook;
-	// decode the AX.25 frame needs extra memory but necessary acting as digipeater
-	// or for displaying/debug purpose.
-	// AS a TNC modem with KISS protocol used, pass_though could be enabled(set=1)
+	// Only the UI frames are handed to the hook, the digipeater and the monitor
+	// handle no others. AS a TNC modem with KISS protocol used, pass_though
+	// could be enabled(set=1) to get all the frames.
 	ctx->pass_through = 0;
-	ctx->crc_in = ctx->crc_out = CRC_CCITT_INIT_VAL;
+#if !CONFIG_AX25_FRAMED_RX
+	ctx->crc_in = CRC_CCITT_INIT_VAL;
+#endif
 }
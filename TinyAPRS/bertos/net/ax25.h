@@ -61,12 +61,12 @@
  */
 #define AX25_CRC_CORRECT 0xF0B8
 
-struct AX25Msg; // fwd declaration
+struct AX25View; // fwd declaration
 
 /**
  * Type for AX25 messages callback.
  */
-typedef void (*ax25_callback_t)(struct AX25Msg *msg);
+typedef void (*ax25_callback_t)(struct AX25View *frm);
 
 #if CONFIG_AX25_STAT
 typedef struct AX25Stat{
@@ -81,16 +81,17 @@ typedef struct AX25Stat{
  */
 typedef struct AX25Ctx
 {
+#if !CONFIG_AX25_FRAMED_RX
 	uint8_t buf[CONFIG_AX25_FRAME_BUF_LEN]; ///< buffer for received chars
-	KFile *ch;        ///< KFile used to access the physical medium
 	size_t frm_len;   ///< received frame length.
 	uint16_t crc_in;  ///< CRC for current received frame
-	uint16_t crc_out; ///< CRC of current sent frame
-	ax25_callback_t hook; ///< Hook function to be called when a message is received
-	bool pass_through;
 	bool sync;   ///< True if we have received a HDLC flag.
 	bool escape; ///< True when we have to escape the following char.
 	uint8_t dcd_state;
+#endif
+	KFile *ch;        ///< KFile used to access the physical medium
+	ax25_callback_t hook; ///< Hook function to be called when a message is received
+	bool pass_through; ///< Call the hook on every frame, not only on the UI frames
 	bool dcd;
 
 #if CONFIG_AX25_STAT
@@ -120,42 +121,68 @@ typedef struct AX25Call
  */
 #define AX25_MAX_RPT 8
 
-/*
- * Has to be lesser than 8 in order to fit in one byte
- * change AX25Msg.rpt_flags if you need more repeaters.
+/**
+ * Length of an address field: the callsign, 6 characters shifted
+ * left by one and padded with spaces, and the SSID byte.
+ */
+#define AX25_ADDR_LEN 7
+
+/**
+ * \name Bits of the SSID byte of an address field.
+ * \{
+ */
+#define AX25_SSID_LAST     0x01 ///< Last address of the frame
+#define AX25_SSID_MASK     0x1E ///< SSID, shifted left by one
+#define AX25_SSID_RESERVED 0x60 ///< Reserved bits, always set
+#define AX25_SSID_REPEATED 0x80 ///< Has-been-repeated flag
+/* \} */
+
+/**
+ * \name Index of the address fields in a frame.
+ * \{
  */
-STATIC_ASSERT(AX25_MAX_RPT <= 8);
+#define AX25_ADDR_DST 0 ///< Destination
+#define AX25_ADDR_SRC 1 ///< Source
+#define AX25_ADDR_RPT 2 ///< First repeater
+/* \} */
 
 /**
- * AX25 Message.
- * Used to handle AX25 sent/received messages.
+ * View of a received AX25 frame.
+ * Points into the frame buffer of the AX25 context and is valid only
+ * in the callback: nothing is copied, the addresses are left in their
+ * on-air form and decoded on demand, \see ax25_viewAddr().
+ * The frame can be edited in place and sent again with ax25_sendRaw().
  */
-typedef struct AX25Msg
+typedef struct AX25View
 {
-	AX25Call src;  ///< Source adress
-	AX25Call dst;  ///< Destination address
-	#if CONFIG_AX25_RPT_LST
-	AX25Call rpt_lst[AX25_MAX_RPT]; ///< List of repeaters
-	uint8_t rpt_cnt; ///< Number of repeaters in this message
-	uint8_t rpt_flags; ///< Has-been-repeated flags for each repeater (bit-mapped)
-	#define AX25_REPEATED(msg, idx) ((msg)->rpt_flags & BV(idx))
-	#endif
-	uint16_t ctrl; ///< AX25 control field
-	uint8_t pid;   ///< AX25 PID field
+	uint8_t *buf;        ///< Frame, from the destination address, FCS excluded
+	size_t len;          ///< Frame length
+	size_t size;         ///< Room for the frame in its buffer, FCS excluded
+	uint8_t addr_cnt;    ///< Address fields, 0 if not an UI frame with no layer 3
 	const uint8_t *info; ///< Pointer to the info field (payload) of the message
-	size_t len;    ///< Payload length
-} AX25Msg;
-
-#if CONFIG_AX25_RPT_LST
-	#define AX25_SET_REPEATED(msg, idx, val) \
-		do \
-		{ \
-			if (val) \
-				(msg)->rpt_flags |= BV(idx) ; \
-			else \
-				(msg)->rpt_flags &= ~BV(idx) ; \
-		} while(0)
-#endif
+	size_t info_len;     ///< Payload length
+} AX25View;
+
+/**
+ * \return the address field \a idx of the frame, \see AX25_ADDR_DST.
+ */
+INLINE uint8_t *ax25_viewAddr(const AX25View *frm, uint8_t idx)
+{
+	ASSERT(idx < frm->addr_cnt);
+	return frm->buf + idx * AX25_ADDR_LEN;
+}
+
+/** \return the SSID of the address field \a addr */
+INLINE uint8_t ax25_addrSsid(const uint8_t *addr)
+{
+	return (addr[AX25_ADDR_LEN - 1] & AX25_SSID_MASK) >> 1;
+}
+
+/** \return true if the has-been-repeated flag of \a addr is set */
+INLINE bool ax25_addrRepeated(const uint8_t *addr)
+{
+	return addr[AX25_ADDR_LEN - 1] & AX25_SSID_REPEATED;
+}
 
 #define AX25_CTRL_UI      0x03
 #define AX25_PID_NOLAYER3 0xF0
@@ -192,12 +219,40 @@ typedef struct AX25Msg
  */
 #define AX25_PATH(dst, src, ...) { dst, src, ## __VA_ARGS__ }
 
+/**
+ * AX25 frame being built, \see ax25_frameStart().
+ * The frame is assembled HDLC escaped, flags included, in a buffer
+ * supplied by the caller, with its CRC computed on every field put.
+ */
+typedef struct AX25Frame
+{
+	AX25Ctx *ctx;  ///< Context the frame is sent to
+	uint8_t *buf;  ///< Frame buffer
+	size_t size;   ///< Size of the frame buffer
+	size_t len;    ///< Bytes in the frame buffer
+	uint16_t crc;  ///< CRC of the frame contents put so far
+} AX25Frame;
+
+/**
+ * Size of a frame buffer that holds any frame with \a len bytes of
+ * contents (addresses, control, PID and payload): every byte may need
+ * an escape, the FCS too, plus the two flags.
+ */
+#define AX25_FRAME_BUF_SIZE(len) (2 * ((len) + 2) + 2)
+
+/** Smallest frame buffer, the largest escaped byte must fit */
+#define AX25_FRAME_BUF_MIN 4
+
+void ax25_frameStart(AX25Ctx *ctx, AX25Frame *frm, uint8_t *buf, size_t size);
+void ax25_framePut(AX25Frame *frm, const void *_buf, size_t len);
+void ax25_frameCall(AX25Frame *frm, const AX25Call *addr, bool last, bool repeated);
+void ax25_frameUI(AX25Frame *frm);
+void ax25_frameEnd(AX25Frame *frm);
+
 void ax25_poll(AX25Ctx *ctx);
 void ax25_sendVia(AX25Ctx *ctx, const AX25Call *path, size_t path_len, const void *_buf, size_t len);
 void ax25_sendRaw(AX25Ctx *ctx, const void *_buf, size_t len);
-void ax25_putchar(AX25Ctx *ctx, uint8_t c);
 
-void ax25_sendMsg(AX25Ctx *ctx, const AX25Msg *msg);
 /**
  * Send an AX25 frame on the channel.
  * \param ctx AX25 context to operate on.
@@ -213,7 +268,14 @@ void ax25_sendMsg(AX25Ctx *ctx, const AX25Msg *msg);
 #define ax25_send(ctx, dst, src, buf, len) ax25_sendVia(ctx, ({static AX25Call __path[]={dst, src}; __path;}), 2, buf, len)
 void ax25_init(AX25Ctx *ctx, KFile *channel, ax25_callback_t hook);
 
-void ax25_print(KFile *ch, const AX25Msg *msg);
+void ax25_addrEncode(uint8_t *addr, const AX25Call *call);
+void ax25_addrDecode(const uint8_t *addr, AX25Call *call);
+bool ax25_addrIsCall(const uint8_t *addr, const AX25Call *call);
+
+void ax25_viewSetAddr(AX25View *frm, uint8_t idx, const AX25Call *call, bool repeated);
+bool ax25_viewInsertAddr(AX25View *frm, uint8_t idx);
+
+void ax25_print(KFile *ch, const AX25View *frm);
 
 int ax25_testSetup(void);
 int ax25_testTearDown(void);
@@ -72,17 +72,25 @@ KFileMem mem1;
 uint8_t aprs_packet_check[256];
 
 
-static void msg_callback(AX25Msg *msg)
+static void msg_callback(AX25View *frm)
 {
-	ax25_print(&dbg.fd, msg);
-	ASSERT(strncmp(msg->dst.call, "APRS\x0\x0", 6) == 0);
-	ASSERT(strncmp(msg->src.call, "S57LN\x0", 6) == 0);
-	ASSERT(msg->src.ssid == 0);
-	ASSERT(msg->dst.ssid == 0);
-	ASSERT(msg->ctrl == AX25_CTRL_UI);
-	ASSERT(msg->pid == AX25_PID_NOLAYER3);
-	ASSERT(msg->len == 30);
-	ASSERT(strncmp((const char *)msg->info, "=4603.63N/01431.26E-Op. Andrej", 30) == 0);
+	static const AX25Call dst = AX25_CALL("APRS", 0);
+	static const AX25Call src = AX25_CALL("s57ln", 0);
+	AX25Call call;
+
+	ax25_print(&dbg.fd, frm);
+	ASSERT(frm->addr_cnt == 2);
+	ax25_addrDecode(ax25_viewAddr(frm, AX25_ADDR_DST), &call);
+	ASSERT(strncmp(call.call, "APRS\x0\x0", 6) == 0);
+	ASSERT(call.ssid == 0);
+	ax25_addrDecode(ax25_viewAddr(frm, AX25_ADDR_SRC), &call);
+	ASSERT(strncmp(call.call, "S57LN\x0", 6) == 0);
+	ASSERT(call.ssid == 0);
+	ASSERT(ax25_addrIsCall(ax25_viewAddr(frm, AX25_ADDR_DST), &dst));
+	ASSERT(ax25_addrIsCall(ax25_viewAddr(frm, AX25_ADDR_SRC), &src));
+	ASSERT(!ax25_addrIsCall(ax25_viewAddr(frm, AX25_ADDR_SRC), &dst));
+	ASSERT(frm->info_len == 30);
+	ASSERT(strncmp((const char *)frm->info, "=4603.63N/01431.26E-Op. Andrej", 30) == 0);
 }
 
 int ax25_testSetup(void)